@@ -1,8 +1,8 @@
 CXX = clang++
 DEPS_BIN = clang++
 DEPSFLAGS =  -std=c++1y -Iexternal/lexer/include -Iexternal/spikes/include -Iexternal/parser/include 
-CXXFLAGS = -O3 -std=c++1y -Wall -Wextra -Iexternal/lexer/include -Iexternal/spikes/include -Iexternal/parser/include 
-LDFLAGS = -O3 -Lexternal/lexer/lib
+CXXFLAGS = -O3 -std=c++1y -pthread -Wall -Wextra -Iexternal/lexer/include -Iexternal/spikes/include -Iexternal/parser/include 
+LDFLAGS = -O3 -pthread -Lexternal/lexer/lib
 LDLIB = -llexer
 AR = ar
 ARFLAGS = rc
@@ -17,17 +17,47 @@ LIB_DIR = lib/
 
 PKG_NAME = alint
 
-SOURCES = src/alint.cpp test/recovery.cpp
+SOURCES = src/alint.cpp test/recovery.cpp test/lsp_benchmark.cpp test/incremental.cpp test/parallel.cpp test/lexer_benchmark.cpp src/libalint.cpp test/libalint.cpp test/generate_corpus.cpp test/bench.cpp test/adversarial.cpp test/format_check.cpp test/range_format.cpp
 
-HEADERS = 
+HEADERS = include/alint/libalint.hpp
 
-BIN = bin/alint bin/test_recovery
+BIN = bin/alint bin/test_recovery bin/lsp_benchmark bin/test_incremental bin/test_parallel bin/lexer_benchmark bin/test_libalint bin/generate_corpus bin/bench bin/test_adversarial bin/test_format_check bin/test_range_format
 
 
 bin/alint: build/src/alint.o
 bin/test_recovery: build/test/recovery.o
+bin/lsp_benchmark: build/test/lsp_benchmark.o
+bin/test_incremental: build/test/incremental.o
+bin/test_parallel: build/test/parallel.o
+bin/lexer_benchmark: build/test/lexer_benchmark.o
+bin/test_libalint: build/test/libalint.o lib/libalint.a
+bin/generate_corpus: build/test/generate_corpus.o
+bin/bench: build/test/bench.o
+bin/test_adversarial: build/test/adversarial.o
+bin/test_format_check: build/test/format_check.o
+bin/test_range_format: build/test/range_format.o
 
 
-LIB = 
+LIB = lib/libalint.a
 
-#lib/lib....a: build/.../.o
+lib/libalint.a: build/src/libalint.o
+
+
+BENCH_CORPUS = build/bench_corpus
+BENCH_RUNS = 5
+BENCH_BASELINE = test/bench_baseline.txt
+
+.PHONY: bench bench-baseline
+
+$(BENCH_CORPUS): bin/generate_corpus
+	@echo "[GEN] " $@
+	@bin/generate_corpus $@
+	@touch $@
+
+# the baseline depends on the machine, it is not versioned
+bench: bin/bench $(BENCH_CORPUS)
+	@test -f $(BENCH_BASELINE) || { echo "no baseline in $(BENCH_BASELINE), run make bench-baseline first."; exit 1; }
+	@bin/bench $(BENCH_CORPUS) $(BENCH_RUNS) $(BENCH_BASELINE)
+
+bench-baseline: bin/bench $(BENCH_CORPUS)
+	@bin/bench $(BENCH_CORPUS) $(BENCH_RUNS) $(BENCH_BASELINE) save
@@ -2,13 +2,19 @@
 #include <fstream>
 #include <set>
 #include <stack>
+#include <chrono>
+#include <thread>
+#include <atomic>
+#include <memory>
 
 #include <cstdlib>
+#include <cerrno>
+#include <cctype>
+#include <new>
 
 #include <unistd.h>
 
 
-#include <spikes/timer.hpp>
 #include <spikes/ansi_iomanip.hpp>
 
 #include <parser/parser.hpp>
@@ -19,8 +25,76 @@
 #include "lexer.hpp"
 #include "syntax_tree.hpp"
 #include "parser.hpp"
+#include "recovery.hpp"
 
 #include "syntax_checkers.hpp"
+#include "format_check.hpp"
+#include "range_format.hpp"
+#include "dependency_graph.hpp"
+#include "site.hpp"
+#include "git_changes.hpp"
+#include "parse_cache.hpp"
+#include "watch.hpp"
+#include "server.hpp"
+#include "lsp.hpp"
+#include "parallel_lexer.hpp"
+#include "parallel_parser.hpp"
+#include "stats.hpp"
+
+
+/*
+ *  The heap allocations of alint go through these to be counted, see
+ *  allocations.hpp.
+ */
+void* operator new(std::size_t size) {
+  void* p(std::malloc(size ? size : 1));
+  if (not p)
+    throw std::bad_alloc();
+  record_allocation(p);
+  return p;
+}
+
+void* operator new[](std::size_t size) {
+  return operator new(size);
+}
+
+void* operator new(std::size_t size, const std::nothrow_t&) noexcept {
+  void* p(std::malloc(size ? size : 1));
+  if (p)
+    record_allocation(p);
+  return p;
+}
+
+void* operator new[](std::size_t size, const std::nothrow_t& t) noexcept {
+  return operator new(size, t);
+}
+
+void operator delete(void* p) noexcept {
+  if (not p)
+    return;
+  record_deallocation(p);
+  std::free(p);
+}
+
+void operator delete[](void* p) noexcept {
+  operator delete(p);
+}
+
+void operator delete(void* p, std::size_t) noexcept {
+  operator delete(p);
+}
+
+void operator delete[](void* p, std::size_t) noexcept {
+  operator delete(p);
+}
+
+void operator delete(void* p, const std::nothrow_t&) noexcept {
+  operator delete(p);
+}
+
+void operator delete[](void* p, const std::nothrow_t&) noexcept {
+  operator delete(p);
+}
 
 
 template<typename token_type>
@@ -30,50 +104,46 @@ public:
   virtual ~error_handler() {}
 
   virtual void operator()(const token_type& t) {
-    std::cout << t.render_coordinates()
-              << " ";
-    if (isatty(1))
-      std::cout << ansi::bold << ansi::color(160) << "error" << ansi::normal;
-    else
-      std::cout << "error";
-
-    std::cout << ": unexpected " << t.symbol
-              << "." << std::endl;
-
-    status = false;
-
     const file_source_coordinate_range* c(
       dynamic_cast<const file_source_coordinate_range*>(
         t.get_coordinates()));
-    
-    show_coordinates_in_file(c->get_filename(), c->get_line(), c->get_column());
+
+    std::ostringstream message;
+    message << "unexpected " << t.symbol << ".";
+    report_diagnostic(diagnostic(c->get_filename(), c->get_line(), c->get_column(),
+                                 "error", message.str(), "parse-error", t.render_coordinates()));
+    status = false;
   }
   
   virtual void operator()(const parse_error<token_type>& e) {
-    this->operator()(e.get_unexpected_token());
+    const token_type& t(e.get_unexpected_token());
+    const file_source_coordinate_range* c(
+      dynamic_cast<const file_source_coordinate_range*>(
+        t.get_coordinates()));
+
+    report_diagnostic(diagnostic(c->get_filename(), c->get_line(), c->get_column(),
+                                 "error", parse_error_message(e), "parse-error",
+                                 t.render_coordinates()));
+    status = false;
   }
 
   bool status;
 };
 
 
-template<typename token_type>
-struct silent_error_handler: public default_error_handler<token_type> {
-public:
-  silent_error_handler() : status(true) {}
-  virtual ~silent_error_handler() {}
-  
-  virtual void operator()(const parse_error<token_type>&) {
-    status = false;
-  }
+/*
+ *  The informative messages, which go to the standard error when the
+ *  standard output carries json or sarif records.
+ */
+std::ostream& message_stream(const options& opt) {
+  return opt.format == "text" ? std::cout : std::cerr;
+}
 
-  bool status;
-};
 
-std::set<std::string> get_dependencies(const std::string& file,
+dependency_list get_dependencies(const std::string& file,
 				       options opt,
 				       lr_parser<symbol>& p,
-                                       cf_grammar<symbol>& g,
+                                       const recovery_table& recovery,
 				       alint_token_source& tokens) {
   using token_type = token<symbol>;
   try {
@@ -81,187 +151,1126 @@ std::set<std::string> get_dependencies(const std::string& file,
     tree_factory<symbol> factory;
 
     silent_error_handler<token_type> handler;
-    basic_node* tree(parse_input_to_tree<alint_token_source,
-		     tree_factory<symbol>,
-                     default_error_handler<token_type>>(p, g, tokens, factory, handler));
+    const std::unique_ptr<basic_node> tree(parse_input_with_recovery(p, recovery, tokens, factory, handler));
+    if (not handler.status)
+      message_stream(opt) << file << ": parse failed" << std::endl;
 
+    /*
+     *  The dependencies outside of the parts recovered from errors.
+     */
     if (tree)
-      return show_input_and_macro_dependencies(tree, opt);
-  }
-  catch (const parse_error<token<symbol> >& e) {
-    std::cout << file << ": parse failed" << std::endl;
+      return extract_dependencies(tree.get(), opt);
   }
   catch (const std::string& e) {
-    std::cout << file << ": parse failed" << std::endl;
+    message_stream(opt) << file << ": parse failed" << std::endl;
+  }
+  catch (const limit_exceeded& e) {
+    e.report();
+  }
+
+  return dependency_list();
+}
+
+
+
+void analyse_file(const std::string& file, options opt,
+                  lr_parser<symbol>& p,
+                  const recovery_table& recovery,
+                  alint_token_source& tokens);
+
+
+void report_parse_error(const parse_error<token<symbol> >& e) {
+  const file_source_coordinate_range* c(
+    dynamic_cast<const file_source_coordinate_range*>(
+      e.get_unexpected_token().get_coordinates()));
+  report_diagnostic(diagnostic(c->get_filename(), c->get_line(), c->get_column(),
+                               "error", parse_error_message(e), "parse-error",
+                               e.get_unexpected_token().render_coordinates()));
+}
+
+
+/*
+ *  Write the edits reformatting the statements which overlap the range
+ *  of the options, one json object per line.
+ */
+void reformat_range(const std::string& file, basic_node* tree,
+                    const std::vector<std::string>& white_spaces,
+                    const options& opt) {
+  std::size_t first_line(opt.range_first), last_line(opt.range_last);
+  if (opt.range_in_bytes) {
+    const std::string source(read_file(file));
+    const std::size_t begin(std::min(opt.range_first, source.size()));
+    const std::size_t end(std::min(std::max(opt.range_last, begin + 1), source.size()));
+    first_line = std::count(source.begin(), source.begin() + begin, '\n') + 1;
+    last_line = first_line + std::count(source.begin() + begin,
+                                        source.begin() + std::max(begin, end - 1), '\n');
   }
 
-  return std::set<std::string>();
+  node* macro_file(find_macro_file(tree));
+  if (not macro_file or macro_file->get_children().size() != 2)
+    return;
+
+  range_formatter formatter(white_spaces, first_line, last_line);
+  formatter.format(static_cast<node*>(macro_file->get_children()[0]), nullptr);
+  for (const auto& e: formatter.get_edits())
+    std::cout << json_value::object()
+      .set("type", "edit")
+      .set("file", file)
+      .set("line", e.first_line)
+      .set("column", e.first_column)
+      .set("end_line", e.last_line)
+      .set("end_column", e.last_column)
+      .set("text", e.text)
+      .dump() << std::endl;
 }
 
 
+/*
+ *  A tree recovered from syntax errors goes through the checkers, but
+ *  it is neither reformatted nor highlighted, and its file counts as
+ *  not formatted.
+ */
+void analyse_tree(const std::string& file, basic_node* tree,
+                  const std::vector<std::string>& white_spaces,
+                  bool recovered,
+                  options opt,
+                  lr_parser<symbol>& p,
+                  const recovery_table& recovery,
+                  alint_token_source& tokens) {
+  default_statistics().count_tree(tree);
+  {
+    phase_timer t("output");
+    default_diagnostic_sink().flush(std::cout);
+    if (not opt.silent and not recovered)
+      message_stream(opt) << file << ": parsing succeed" << std::endl;
+
+    if (opt.verbose)
+      tree->show(std::cout);
+  }
+
+  if (opt.run_checkers) {
+    {
+      phase_timer t("do-enddo-guards");
+      check_do_enddo_guards(tree);
+    }
+    {
+      phase_timer t("white-spaces");
+      check_white_spaces(tree, white_spaces);
+    }
+  }
+  {
+    phase_timer t("output");
+    default_diagnostic_sink().flush(std::cout);
+  }
+
+  /*
+   *  In the json and sarif formats, the dependencies are written as the
+   *  edges of the dependency graph.
+   */
+  const bool edges(opt.format != "text");
+  auto write_edges([](const std::string& f, const dependency_list& dependencies) {
+      for (const auto& d: dependencies) {
+        std::ostringstream kind;
+        kind << d.second;
+        default_diagnostic_sink().add_dependency(std::cout, f, d.first, kind.str());
+      }
+    });
+
+  if (opt.show_dependencies) {
+    if (not opt.recursive_parse and edges) {
+      write_edges(file, extract_dependencies(tree, opt));
+    } else if (not opt.recursive_parse) {
+      std::set<std::string> filenames(show_input_and_macro_dependencies(tree, opt));
+      for (const auto& f: filenames)
+	std::cout << f << std::endl;
+    } else {
+      std::set<std::string> visited;
+      std::stack<std::string> unvisited;
+      unvisited.push(file);
+      while (unvisited.size()) {
+	const std::string f(unvisited.top());
+	unvisited.pop();
+	visited.insert(f);
+
+	dependency_list deps(get_dependencies(f, opt, p, recovery, tokens));
+	if (edges)
+	  write_edges(f, deps);
+	for (const auto& d: deps)
+	  if (visited.count(d.first) == 0)
+	    unvisited.push(d.first);
+      }
+
+      if (not edges)
+	for (const auto& f: visited)
+	  std::cout << f << std::endl;
+    }
+  } else if (opt.recursive_parse) {
+    std::set<std::string> filenames(show_input_and_macro_dependencies(tree, opt));
+    for (const auto& f: filenames)
+      analyse_file(f, opt, p, recovery, tokens);
+  }
+
+  if (opt.check_format) {
+    phase_timer t("format check");
+    if (recovered)
+      ++unformatted_files();
+    else
+      check_format(file, tree, white_spaces);
+  }
+
+  if (recovered)
+    return;
+
+  if (opt.reformat_source and opt.range_format) {
+    phase_timer t("range format");
+    reformat_range(file, tree, white_spaces, opt);
+  } else if (opt.reformat_source) {
+    phase_timer t("reformat");
+    reformat(tree, white_spaces, std::cout);
+  }
+
+  if (opt.html_highlight) {
+    phase_timer t("html");
+    html_highlight(tree, white_spaces, std::cout);
+  }
+}
+
 
 void analyse_file(const std::string& file, options opt,
                   lr_parser<symbol>& p,
-                  cf_grammar<symbol>& g,
+                  const recovery_table& recovery,
                   alint_token_source& tokens) {
   using token_type = token<symbol>;
+  trace_span span("file", file);
+  statistics& stats(default_statistics());
+  stats.begin_file(file);
   try {
-    tokens.set_file(file);
+    {
+      phase_timer t("lex");
+      if (opt.jobs > 1)
+        lex_file_in_parallel(tokens, file, opt.jobs);
+      else
+        tokens.set_file(file);
+
+      /*
+       *  To time the lexer and the parser apart, the whole file is
+       *  lexed first and its tokens replayed to the parser. The lexing
+       *  pass lexes it all too, then lists the tokens.
+       */
+      if (stats.is_enabled() or not opt.parsing_pass)
+        tokens.lex_to_end();
+    }
 
     if (opt.parsing_pass) {
       tree_factory<symbol> factory;
       error_handler<token_type> handler;
-      basic_node* tree(parse_input_to_tree<alint_token_source,
-		       tree_factory<symbol>,
-                       default_error_handler<token_type>>(p, g, tokens, factory, handler));
-          
+      std::unique_ptr<basic_node> tree;
+      {
+        phase_timer t("parse");
+        if (opt.jobs > 1)
+          tree.reset(parse_in_parallel(p, recovery, tokens.get_lexems(), opt.jobs, handler));
+        else if (stats.is_enabled()) {
+          const std::vector<token_type*>& lexems(tokens.get_lexems());
+          token_replay_source input(lexems.data(), lexems.data() + lexems.size(), 1);
+          tree.reset(parse_input_with_recovery(p, recovery, input, factory, handler));
+        }
+        else
+          tree.reset(parse_input_with_recovery(p, recovery, tokens, factory, handler));
+      }
+      stats.set_tokens(tokens.get_lexems().size());
+
       if (tree) {
-	if (not opt.silent)
-	  std::cout << file << ": parsing succeed" << std::endl;
-
-	if (opt.verbose)
-	  tree->show(std::cout);
-
-	if (opt.run_checkers) {
-	  check_do_enddo_guards(tree);
-	  check_white_spaces(tree, tokens.get_white_spaces());
-	}
-
-	if (opt.show_dependencies) {
-	  if (not opt.recursive_parse) {
-	    std::set<std::string> filenames(show_input_and_macro_dependencies(tree, opt));
-	    for (const auto& f: filenames)
-	      std::cout << f << std::endl;
-	  } else {
-	    std::set<std::string> visited;
-	    std::stack<std::string> unvisited;
-	    unvisited.push(file);
-	    while (unvisited.size()) {
-	      const std::string f(unvisited.top());
-	      unvisited.pop();
-	      visited.insert(f);
-
-	      std::set<std::string> deps(get_dependencies(f, opt, p, g, tokens));
-	      for (const auto& d: deps)
-		if (visited.count(d) == 0)
-		  unvisited.push(d);
-	    }
-
-	    for (const auto& f: visited)
-	      std::cout << f << std::endl;
-	  }
-	} else if (opt.recursive_parse) {
-	  std::set<std::string> filenames(show_input_and_macro_dependencies(tree, opt));
-	  for (const auto& f: filenames)
-	    analyse_file(f, opt, p, g, tokens);
-	}
-
-	if (opt.reformat_source)
-	  reformat(tree, tokens.get_white_spaces(), std::cout);
-
-        if (opt.html_highlight)
-          html_highlight(tree, tokens.get_white_spaces(), std::cout);
-        
-	delete tree;
-	tree = nullptr;
+        tokens.get_budget().check_time();
+        analyse_tree(file, tree.get(), tokens.get_white_spaces(), not handler.status, opt, p, recovery, tokens);
       }
     } else if (opt.lexing_pass) {
-      while (tokens.get().symbol != symbol::eoi) {
-	if (opt.verbose)
-	  std::cout << tokens.get().symbol << " "
-		    << tokens.get().value << std::endl;
-	tokens.next();
-      }
+      stats.set_tokens(tokens.get_lexems().size());
+      if (opt.verbose)
+        for (const auto lexem: tokens.get_lexems())
+          if (lexem->symbol != symbol::eoi)
+            std::cout << lexem->symbol << " " << lexem->value << std::endl;
       if (not opt.silent)
-	std::cout << file << ": lexing succeed" << std::endl;
+	message_stream(opt) << file << ": lexing succeed" << std::endl;
     } else {
       throw std::string("error: no pass to check.");
     }
   }
   catch (const parse_error<token<symbol> >& e) {
-    std::cout << e.get_unexpected_token().render_coordinates()
-	      << " error: unexpected " << e.get_unexpected_token().symbol;
+    report_parse_error(e);
+  }
+  catch (const std::string& e) {
+    message_stream(opt) << e << std::endl;
+  }
+  catch (const limit_exceeded& e) {
+    e.report();
+  }
+  {
+    phase_timer t("output");
+    default_diagnostic_sink().flush(std::cout);
+  }
+  stats.end_file(message_stream(opt));
+}
 
-    if (e.get_unexpected_token().value.size())
-      std::cout << " (" << e.get_unexpected_token().value << ")";
 
-    if (e.get_expected_symbols().size() == 1)
-      std::cout << " instead of a " << e.get_expected_symbols().front() << ".";
-    else
-      std::cout << ".";
+/*
+ *  Same as analyse_file, but the tree is taken from, or stored into,
+ *  the parse cache.
+ */
+void analyse_cached_file(const std::string& file, options opt,
+                         lr_parser<symbol>& p,
+                         const recovery_table& recovery,
+                         alint_token_source& tokens,
+                         parse_cache& cache) {
+  trace_span span("file", file);
+  statistics& stats(default_statistics());
+  stats.begin_file(file);
+  try {
+    error_handler<token<symbol> > handler;
+    const parsed_file* parsed(nullptr);
+    {
+      phase_timer t("cached parse");
+      parsed = &cache.get(file, p, recovery, tokens, handler);
+    }
+    stats.set_tokens(parsed->white_spaces.size());
+    analyse_tree(file, parsed->tree, parsed->white_spaces, parsed->recovered, opt, p, recovery, tokens);
+  }
+  catch (const parse_error<token<symbol> >& e) {
+    report_parse_error(e);
+  }
+  catch (const std::string& e) {
+    message_stream(opt) << e << std::endl;
+  }
+  catch (const limit_exceeded& e) {
+    e.report();
+  }
+  {
+    phase_timer t("output");
+    default_diagnostic_sink().flush(std::cout);
+  }
+  stats.end_file(message_stream(opt));
+}
+
+enum class reformat_outcome {
+  unchanged, changed, failed
+};
 
-    std::cout << std::endl;
+/*
+ *  Reformat a file and write it back if its content changes. The white
+ *  spaces at its end, which the reformatting drops, are kept. A file
+ *  with syntax errors, or with invalid characters which the lexer
+ *  skipped and the reformatting would drop, is left as it is.
+ */
+reformat_outcome reformat_file_in_place(const std::string& file,
+                                        lr_parser<symbol>& p,
+                                        const recovery_table& recovery,
+                                        alint_token_source& tokens) {
+  using token_type = token<symbol>;
+  tokens.set_file(file);
+  tree_factory<symbol> factory;
+  error_handler<token_type> handler;
+  basic_node* tree(parse_input_with_recovery(p, recovery, tokens, factory, handler));
+  if (not tree or not handler.status or tokens.has_lex_errors()) {
+    delete tree;
+    return reformat_outcome::failed;
+  }
 
-    const file_source_coordinate_range* c(
-					  dynamic_cast<const file_source_coordinate_range*>(
-											    e.get_unexpected_token().get_coordinates()));
-    show_coordinates_in_file(c->get_filename(), c->get_line(), c->get_column());
+  std::ostringstream output;
+  try {
+    reformat(tree, tokens.get_white_spaces(), output);
+  }
+  catch (...) {
+    delete tree;
+    throw;
+  }
+  delete tree;
+  output << tokens.get_white_spaces().back();
+
+  const std::string formatted(output.str());
+  if (formatted == read_file(file))
+    return reformat_outcome::unchanged;
+  write_file_atomically(file, formatted);
+  return reformat_outcome::changed;
+}
+
+
+/*
+ *  Call process(i, tokens) for each file i on opt.jobs threads, or one
+ *  per core by default, each with its own lexer, until the run fails.
+ *  Returns the errors thrown, by file.
+ */
+template<typename process_type>
+std::vector<std::string> process_files_in_parallel(const std::vector<std::string>& files,
+                                                   const options& opt,
+                                                   const resource_limits& limits,
+                                                   process_type process) {
+  std::vector<std::string> errors(files.size());
+  std::atomic<std::size_t> next_file(0);
+
+  const std::size_t jobs(opt.jobs ? opt.jobs
+                         : std::max(1u, std::thread::hardware_concurrency()));
+  std::vector<std::thread> threads;
+  for (std::size_t j(0); j < std::min(jobs, files.size()); ++j)
+    threads.push_back(std::thread([&]() {
+          alint_token_source tokens;
+          tokens.set_limits(limits);
+          for (std::size_t i(next_file++); i < files.size(); i = next_file++) {
+            if (default_diagnostic_sink().failed())
+              return;
+            try {
+              process(i, tokens);
+            }
+            catch (const std::string& e) {
+              errors[i] = e;
+            }
+            catch (const limit_exceeded& e) {
+              e.report();
+            }
+          }
+        }));
+  for (auto& t: threads)
+    t.join();
+
+  default_diagnostic_sink().flush(std::cout);
+  return errors;
+}
+
+
+/*
+ *  Reformat the files in place in parallel, then list the files
+ *  changed.
+ */
+void reformat_files_in_place(const std::vector<std::string>& files,
+                             options opt,
+                             lr_parser<symbol>& p,
+                             const recovery_table& recovery,
+                             const resource_limits& limits) {
+  std::vector<reformat_outcome> outcomes(files.size(), reformat_outcome::failed);
+  const std::vector<std::string> errors(
+    process_files_in_parallel(files, opt, limits, [&](std::size_t i, alint_token_source& tokens) {
+        outcomes[i] = reformat_file_in_place(files[i], p, recovery, tokens);
+      }));
+
+  std::size_t changed(0), failed(0);
+  for (std::size_t i(0); i < files.size(); ++i) {
+    if (not errors[i].empty())
+      message_stream(opt) << errors[i] << std::endl;
+    if (outcomes[i] == reformat_outcome::changed) {
+      ++changed;
+      if (not opt.silent)
+        message_stream(opt) << "reformatted " << files[i] << std::endl;
+    }
+    failed += outcomes[i] == reformat_outcome::failed;
+  }
+  if (not opt.silent)
+    message_stream(opt) << changed << " files reformatted, "
+                        << files.size() - changed - failed << " unchanged, "
+                        << failed << " failed." << std::endl;
+}
+
+
+/*
+ *  Check the format of the files in parallel, with nothing else: a file
+ *  with syntax errors counts as not formatted, the others are compared
+ *  with their reformatted tree.
+ */
+void check_files_format(const std::vector<std::string>& files,
+                        options opt,
+                        lr_parser<symbol>& p,
+                        const recovery_table& recovery,
+                        const resource_limits& limits) {
+  using token_type = token<symbol>;
+  const std::vector<std::string> errors(
+    process_files_in_parallel(files, opt, limits, [&](std::size_t i, alint_token_source& tokens) {
+        tokens.set_file(files[i]);
+        tree_factory<symbol> factory;
+        error_handler<token_type> handler;
+        std::unique_ptr<basic_node> tree(parse_input_with_recovery(p, recovery, tokens, factory, handler));
+        if (not tree or not handler.status)
+          ++unformatted_files();
+        else
+          check_format(files[i], tree.get(), tokens.get_white_spaces());
+      }));
+
+  for (const auto& e: errors)
+    if (not e.empty())
+      message_stream(opt) << e << std::endl;
+  if (not opt.silent)
+    message_stream(opt) << files.size() << " files checked, "
+                        << unformatted_files() << " not formatted." << std::endl;
+}
+
+
+/*
+ *  Load the dependency index if any, and bring it up to date with the
+ *  files it already knows and with the given files.
+ */
+void load_dependency_graph(dependency_graph& graph,
+                           const std::vector<std::string>& files,
+                           options opt,
+                           lr_parser<symbol>& p,
+                           const recovery_table& recovery,
+                           alint_token_source& tokens) {
+  if (not opt.dependency_index.empty())
+    graph.load(opt.dependency_index);
+
+  auto extract([&](const std::string& f) {
+      return get_dependencies(f, opt, p, recovery, tokens);
+    });
+
+  std::size_t parsed(graph.update(extract));
+  parsed += graph.update(files, extract);
+
+  if (not opt.silent)
+    message_stream(opt) << "dependency index: " << graph.get_files().size() << " files, "
+                        << parsed << " parsed" << std::endl;
+}
+
+void update_dependency_graph(const std::vector<std::string>& files,
+                             options opt,
+                             lr_parser<symbol>& p,
+                             const recovery_table& recovery,
+                             alint_token_source& tokens) {
+  dependency_graph graph;
+  load_dependency_graph(graph, files, opt, p, recovery, tokens);
+
+  if (not opt.dependency_index.empty())
+    graph.save(opt.dependency_index);
+
+  for (const auto& f: opt.reverse_dependencies)
+    for (const auto& r: graph.get_reverse_dependencies(f))
+      std::cout << r << std::endl;
+}
+
+/*
+ *  Render the page of a file of a site. A file with syntax errors is
+ *  rendered as plain text.
+ */
+void render_site_page(const std::string& file, const std::string& directory,
+                      const std::set<std::string>& files,
+                      const dependency_graph& graph,
+                      const options& opt,
+                      lr_parser<symbol>& p,
+                      const recovery_table& recovery,
+                      alint_token_source& tokens) {
+  using token_type = token<symbol>;
+  const std::string page(site_page_name(file));
+  tokens.set_file(file);
+  tree_factory<symbol> factory;
+  error_handler<token_type> handler;
+  basic_node* tree(parse_input_with_recovery(p, recovery, tokens, factory, handler));
+
+  std::ostringstream code;
+  if (tree and handler.status) {
+    site_links links(opt, page, files);
+    html_highlight_printer printer(code, tokens.get_white_spaces(), &links);
+    try {
+      tree->accept(&printer);
+    }
+    catch (...) {
+      delete tree;
+      throw;
+    }
+    code << tokens.get_white_spaces().back();
+  } else {
+    code << html_escape(read_file(file));
+  }
+  delete tree;
+
+  const std::string path(directory + "/" + page);
+  make_directories(path.substr(0, path.rfind('/')));
+  write_file(path, site_page(file, code.str(), site_references(file, graph, files)));
+}
+
+
+/*
+ *  Render the html site of the macro tree of the files in the opt.site
+ *  directory. The dependency index of the tree is kept in the
+ *  directory, and only the pages whose fingerprint changed are
+ *  rendered, on opt.jobs threads or one per core, each with its own
+ *  lexer. The pages of the files no longer in the tree are removed.
+ */
+void generate_site(const std::vector<std::string>& roots,
+                   options opt,
+                   lr_parser<symbol>& p,
+                   const recovery_table& recovery,
+                   alint_token_source& tokens,
+                   const resource_limits& limits) {
+  const std::string directory(opt.site);
+  const std::string index(directory + "/.alint-index");
+  const std::string manifest_file(directory + "/.alint-site");
+  make_directories(directory);
+
+  dependency_graph graph;
+  graph.load(index);
+  graph.update(roots, [&](const std::string& f) {
+      return get_dependencies(f, opt, p, recovery, tokens);
+    });
+  graph.save(index);
+
+  const std::set<std::string> files(site_files(graph, roots));
+  site_manifest manifest;
+  manifest.load(manifest_file);
+
+  std::vector<std::string> pending;
+  std::vector<std::uint64_t> fingerprints;
+  for (const auto& f: files) {
+    const std::uint64_t fingerprint(site_page_fingerprint(f, graph, files));
+    if (fingerprint != manifest.get_fingerprint(f)
+        or not get_modification_time(directory + "/" + site_page_name(f))) {
+      pending.push_back(f);
+      fingerprints.push_back(fingerprint);
+    }
+  }
+
+  std::vector<char> rendered(pending.size(), false);
+  const std::vector<std::string> errors(
+    process_files_in_parallel(pending, opt, limits, [&](std::size_t i, alint_token_source& tokens) {
+        render_site_page(pending[i], directory, files, graph, opt, p, recovery, tokens);
+        rendered[i] = true;
+      }));
+
+  std::size_t count(0);
+  for (std::size_t i(0); i < pending.size(); ++i) {
+    if (not errors[i].empty())
+      message_stream(opt) << errors[i] << std::endl;
+    if (rendered[i]) {
+      manifest.set_fingerprint(pending[i], fingerprints[i]);
+      ++count;
+    }
+  }
+
+  std::vector<std::string> removed;
+  for (const auto& page: manifest.get_pages())
+    if (not files.count(page.first))
+      removed.push_back(page.first);
+  for (const auto& f: removed) {
+    std::remove((directory + "/" + site_page_name(f)).c_str());
+    manifest.remove(f);
+  }
+
+  const std::string index_page(directory + "/index.html");
+  const std::string index_content(site_index(files));
+  if (not get_modification_time(index_page) or read_file(index_page) != index_content)
+    write_file(index_page, index_content);
+  if (not get_modification_time(directory + "/alint.css"))
+    write_file(directory + "/alint.css", site_stylesheet());
+  manifest.save(manifest_file);
+
+  if (not opt.silent)
+    message_stream(opt) << "site: " << files.size() << " pages, " << count << " rendered, "
+                        << removed.size() << " removed." << std::endl;
+}
+
+
+/*
+ *  Lint the files changed between two git revisions, and every file
+ *  which transitively depends on them.
+ */
+void lint_changed_files(const std::vector<std::string>& files,
+                        options opt,
+                        lr_parser<symbol>& p,
+                        const recovery_table& recovery,
+                        alint_token_source& tokens) {
+  using clock = std::chrono::steady_clock;
+  const clock::time_point start(clock::now());
+
+  dependency_graph graph;
+  load_dependency_graph(graph, files, opt, p, recovery, tokens);
+
+  const std::set<std::string> changed(get_changed_files(opt.changed_revisions));
+  std::set<std::string> affected(graph.get_reverse_dependencies(changed));
+  for (const auto& f: changed)
+    if (graph.contains(f))
+      affected.insert(f);
+
+  message_stream(opt) << "affected files: " << affected.size()
+                      << " of " << graph.get_files().size() << std::endl;
+  for (const auto& f: affected)
+    message_stream(opt) << "  " << f << std::endl;
+
+  for (const auto& f: affected) {
+    if (get_modification_time(f) == 0 or default_diagnostic_sink().failed())
+      continue;
+
+    const clock::time_point file_start(clock::now());
+    analyse_file(f, opt, p, recovery, tokens);
+    graph.set_analysis_time(f, std::chrono::duration<double>(clock::now() - file_start).count());
+  }
+
+  if (not opt.dependency_index.empty())
+    graph.save(opt.dependency_index);
+
+  std::size_t unestimated(0);
+  const double full_run_time(graph.get_full_analysis_time(unestimated));
+  const double elapsed(std::chrono::duration<double>(clock::now() - start).count());
+  message_stream(opt) << "elapsed: " << elapsed << "s";
+  if (full_run_time > 0.0 and unestimated == 0)
+    message_stream(opt) << ", estimated full run: " << full_run_time << "s"
+                        << ", saved: " << full_run_time - elapsed << "s";
+  else if (full_run_time > 0.0)
+    message_stream(opt) << ", estimated full run: at least " << full_run_time << "s"
+                        << " (partial, " << unestimated << " files never linted)";
+  message_stream(opt) << std::endl;
+}
+
+/*
+ *  Watch the directories, and the macro directories, and lint the
+ *  modified files and their dependents as soon as they are saved. The
+ *  trees of the files are kept in memory between two lints.
+ */
+void watch_directories(const std::vector<std::string>& directories,
+                       options opt,
+                       lr_parser<symbol>& p,
+                       const recovery_table& recovery,
+                       alint_token_source& tokens) {
+  using clock = std::chrono::steady_clock;
+  const int quiet_period(20);
+
+  std::set<std::string> watched;
+  for (const auto& d: directories)
+    watched.insert(canonical_path(d));
+  if (not opt.global_macro_dir.empty())
+    watched.insert(canonical_path(opt.global_macro_dir));
+  if (not opt.local_macro_dir.empty())
+    watched.insert(canonical_path(opt.local_macro_dir));
+
+  if (watched.empty())
+    throw std::string("error: no directory to watch.");
+
+  directory_watcher watcher;
+  std::vector<std::string> files;
+  for (const auto& d: watched)
+    watcher.add_directory(d, files);
+
+  parse_cache cache;
+  auto extract([&](const std::string& f) {
+      try {
+        silent_error_handler<token<symbol> > handler;
+        return extract_dependencies(cache.get(f, p, recovery, tokens, handler).tree, opt);
+      }
+      catch (const parse_error<token<symbol> >& e) {}
+      catch (const std::string& e) {}
+      catch (const limit_exceeded& e) {
+        e.report();
+      }
+      return dependency_list();
+    });
+
+  std::vector<std::string> macro_files;
+  for (const auto& f: files)
+    if (is_macro_file(f))
+      macro_files.push_back(f);
+
+  dependency_graph graph;
+  graph.update(macro_files, extract);
+
+  message_stream(opt) << "watching " << watched.size() << " directories, "
+                      << graph.get_files().size() << " files." << std::endl;
+
+  while (true) {
+    std::set<std::string> changed;
+    for (const auto& f: watcher.wait_for_changes(quiet_period)) {
+      const std::string c(canonical_path(f));
+      if (is_macro_file(c) or graph.contains(c))
+        changed.insert(c);
+    }
+
+    if (changed.empty())
+      continue;
+
+    const clock::time_point start(clock::now());
+
+    graph.update(std::vector<std::string>(changed.begin(), changed.end()), extract);
+    std::set<std::string> affected(graph.get_reverse_dependencies(changed));
+    affected.insert(changed.begin(), changed.end());
+
+    std::size_t linted(0);
+    for (const auto& f: affected) {
+      if (get_modification_time(f) == 0) {
+        cache.erase(f);
+        continue;
+      }
+
+      analyse_cached_file(f, opt, p, recovery, tokens, cache);
+      ++linted;
+    }
+
+    message_stream(opt) << "linted " << linted << " files in "
+                        << std::chrono::duration<double, std::milli>(clock::now() - start).count()
+                        << "ms." << std::endl;
+  }
+}
+
+std::size_t parse_limit(const std::string& name, const std::string& value) {
+  char* end(nullptr);
+  errno = 0;
+  const std::size_t limit(std::strtoul(value.c_str(), &end, 10));
+  // strtoul skips the spaces and negates the values after a '-'
+  if (value.empty() or not std::isdigit(static_cast<unsigned char>(value[0]))
+      or *end or errno == ERANGE)
+    throw std::string("error: invalid value for ") + name + ": " + value;
+  return limit;
+}
+
+void parse_range(const std::string& name, const std::string& value, options& opt) {
+  const std::string::size_type colon(value.find(':'));
+  if (colon == std::string::npos)
+    throw std::string("error: invalid range for ") + name + ": " + value;
+
+  opt.range_format = true;
+  opt.range_in_bytes = name == "--bytes";
+  opt.range_first = parse_limit(name, value.substr(0, colon));
+  opt.range_last = parse_limit(name, value.substr(colon + 1));
+  if (opt.range_last < opt.range_first or (not opt.range_in_bytes and opt.range_first == 0))
+    throw std::string("error: invalid range for ") + name + ": " + value;
+}
+
+void parse_long_option(const std::string& arg, options& opt) {
+  const std::string::size_type equal_position(arg.find('='));
+  const std::string name(arg.substr(0, equal_position));
+  const std::string value(equal_position == std::string::npos ?
+                          "" : arg.substr(equal_position + 1));
+
+  if (name == "--index" and not value.empty())
+    opt.dependency_index = value;
+  else if (name == "--reverse-dependencies" and not value.empty())
+    opt.reverse_dependencies.push_back(value);
+  else if (name == "--changed" and not value.empty())
+    opt.changed_revisions = value;
+  else if (name == "--watch" and value.empty())
+    opt.watch = true;
+  else if (name == "--trace" and not value.empty())
+    opt.trace = value;
+  else if (name == "--in-place" and value.empty())
+    opt.in_place = true;
+  else if (name == "--check" and value.empty())
+    opt.check_format = true;
+  else if ((name == "--lines" or name == "--bytes") and not value.empty())
+    parse_range(name, value, opt);
+  else if (name == "--stats" and value.empty())
+    opt.stats = true;
+  else if (name == "--allocations" and value.empty())
+    opt.allocations = true;
+  else if (name == "--lsp" and value.empty())
+    opt.language_server = true;
+  else if (name == "--format" and not value.empty()) {
+    if (value != "text" and value != "json" and value != "sarif")
+      throw std::string("error: unknown output format: ") + value;
+    opt.format = value;
+  }
+  else if (name == "--site" and not value.empty())
+    opt.site = value;
+  else if (name == "--files-from" and not value.empty())
+    opt.files_from = value;
+  else if (name == "--fail-fast" and value.empty())
+    opt.fail_fast = true;
+  else if (name == "--max-file-size" and not value.empty())
+    opt.max_file_size = parse_limit(name, value);
+  else if (name == "--max-tokens" and not value.empty())
+    opt.max_tokens = parse_limit(name, value);
+  else if (name == "--max-depth" and not value.empty())
+    opt.max_depth = parse_limit(name, value);
+  else if (name == "--max-diagnostics" and not value.empty())
+    opt.max_diagnostics = parse_limit(name, value);
+  else if (name == "--timeout" and not value.empty()) {
+    char* end(nullptr);
+    opt.timeout = std::strtod(value.c_str(), &end);
+    if (*end or opt.timeout < 0.0)
+      throw std::string("error: invalid timeout: ") + value;
+  }
+  else if (name == "--jobs" and not value.empty()) {
+    char* end(nullptr);
+    opt.jobs = std::strtoul(value.c_str(), &end, 10);
+    if (*end or opt.jobs == 0)
+      throw std::string("error: invalid number of jobs: ") + value;
+  }
+  else if (name == "--server" or name == "--client") {
+    opt.server = name == "--server";
+    opt.client = name == "--client";
+    opt.socket_path = value.empty() ? default_socket_path() : value;
+  }
+  else
+    throw std::string("unrecognize option: ") + arg;
+}
+
+void parse_arguments(const std::vector<std::string>& arguments,
+                     options& opt,
+                     std::vector<std::string>& files) {
+  for (const auto& argument: arguments) {
+    if (argument.empty() or argument[0] != '-') {
+      files.push_back(argument);
+    } else if (argument.size() > 1 and argument[1] == '-') {
+      parse_long_option(argument, opt);
+    } else {
+      if (argument.size() != 2)
+	throw std::string("unrecognize option: ") + argument;
+
+      switch (argument[1]) {
+      case 'l':
+	opt.lexing_pass = true;
+	opt.parsing_pass = false;
+	break;
+      case 'v':
+	opt.verbose = true;
+	break;
+      case 'd':
+	opt.show_dependencies = true;
+	break;
+      case 'c':
+	opt.run_checkers = true;
+	break;
+      case 's':
+	opt.silent = true;
+	break;
+      case 'f':
+	opt.reformat_source = true;
+	break;
+      case 'r':
+	opt.recursive_parse = true;
+	break;
+      case 'g':
+	opt.show_grammar = true;
+	break;
+      case 'h':
+	opt.html_highlight = true;
+	break;
+      default:
+	throw std::string("unrecognize option: ") + argument;
+      }
+    }
+  }
+
+  if (opt.in_place and not opt.reformat_source)
+    throw std::string("error: --in-place needs -f.");
+
+  if (opt.range_format and (not opt.reformat_source or opt.in_place))
+    throw std::string("error: --lines and --bytes need -f, without --in-place.");
+
+  const bool dependency_graph_mode(not opt.dependency_index.empty()
+                                   or not opt.reverse_dependencies.empty());
+  if (files.empty() and opt.files_from.empty() and not dependency_graph_mode
+      and opt.changed_revisions.empty() and not opt.watch and not opt.server
+      and not opt.language_server)
+    throw std::string("wrong number of arguments.");
+}
+
+
+/*
+ *  State which is expensive to build, and is shared by all the
+ *  invocations handled by a server.
+ */
+struct alint_context {
+  using clock = std::chrono::steady_clock;
+
+  alint_context()
+    : start(clock::now()), g(build_cf_grammar()), grammar_built(clock::now()),
+      p(g), parser_built(clock::now()), recovery(p, g), recovery_built(clock::now()),
+      setup_time(std::chrono::duration<double>(clock::now() - start).count()) {
+    default_trace().add_span("build_cf_grammar", start, grammar_built);
+    default_trace().add_span("lr_parser", grammar_built, parser_built);
+    default_trace().add_span("recovery_table", parser_built, recovery_built);
+  }
+
+  clock::time_point start;
+  cf_grammar<symbol> g;
+  clock::time_point grammar_built;
+  lr_parser<symbol> p;
+  clock::time_point parser_built;
+  recovery_table recovery;
+  clock::time_point recovery_built;
+  alint_token_source tokens;
+  parse_cache cache;
+
+  /*
+   *  Time to build the grammar, the parsing tables and the lexer.
+   */
+  double setup_time;
+};
+
+
+int run(options opt, std::vector<std::string> files,
+        alint_context& context, bool use_cache) {
+  lr_parser<symbol>& p(context.p);
+  const recovery_table& recovery(context.recovery);
+  alint_token_source& tokens(context.tokens);
+
+  /*
+   *  The listed files are linted as they are read, the other modes
+   *  need all of them at once.
+   */
+  const bool dependency_graph_mode(not opt.dependency_index.empty()
+                                   or not opt.reverse_dependencies.empty());
+  if (not opt.files_from.empty()
+      and (opt.watch or not opt.changed_revisions.empty() or dependency_graph_mode)) {
+    for_each_listed_file(opt.files_from, [&](const std::string& f) {
+        files.push_back(f);
+      });
+    opt.files_from.clear();
+  }
+
+  resource_limits limits;
+  limits.max_file_size = opt.max_file_size;
+  limits.max_tokens = opt.max_tokens;
+  limits.max_diagnostics = opt.max_diagnostics;
+  limits.max_depth = opt.max_depth;
+  limits.timeout = opt.timeout;
+
+  if (opt.language_server) {
+    // the standard output carries the protocol
+    opt.warn_about_environment(std::cerr);
+    language_server server(opt, limits, p, recovery);
+    return server.run(std::cin, std::cout);
+  }
+
+  diagnostic_sink& sink(default_diagnostic_sink());
+  sink.set_format(opt.format == "json" ? output_format::json
+                  : opt.format == "sarif" ? output_format::sarif
+                  : output_format::text);
+  sink.set_colors(opt.colors);
+  opt.warn_about_environment(message_stream(opt));
+
+  tokens.set_limits(limits);
+  sink.set_max_diagnostics(opt.max_diagnostics);
+  sink.set_fail_fast(opt.fail_fast);
+
+  statistics& stats(default_statistics());
+  stats = statistics();
+  stats.set_enabled(opt.stats or opt.allocations);
+  stats.set_allocations(opt.allocations);
+  stats.set_setup_time(context.setup_time);
+
+  if (opt.show_grammar)
+    p.print(std::cout, context.g);
+
+  unformatted_files() = 0;
+  sink.begin(std::cout);
+  if (opt.watch) {
+    watch_directories(files, opt, p, recovery, tokens);
+  } else if (not opt.changed_revisions.empty()) {
+    lint_changed_files(files, opt, p, recovery, tokens);
+  } else if (dependency_graph_mode) {
+    update_dependency_graph(files, opt, p, recovery, tokens);
+  } else if (not opt.site.empty()) {
+    if (not opt.files_from.empty())
+      for_each_listed_file(opt.files_from, [&](const std::string& f) {
+          files.push_back(f);
+        });
+    generate_site(files, opt, p, recovery, tokens, limits);
+  } else if (opt.in_place) {
+    if (not opt.files_from.empty())
+      for_each_listed_file(opt.files_from, [&](const std::string& f) {
+          files.push_back(f);
+        });
+    reformat_files_in_place(files, opt, p, recovery, limits);
+  } else if (opt.check_format and opt.parsing_pass and not opt.run_checkers
+             and not opt.show_dependencies and not opt.reformat_source
+             and not opt.html_highlight and not opt.recursive_parse and not opt.verbose) {
+    if (not opt.files_from.empty())
+      for_each_listed_file(opt.files_from, [&](const std::string& f) {
+          files.push_back(f);
+        });
+    check_files_format(files, opt, p, recovery, limits);
+  } else {
+    auto lint([&](const std::string& file) {
+        if (sink.failed())
+          return;
+        if (use_cache and opt.parsing_pass)
+          analyse_cached_file(file, opt, p, recovery, tokens, context.cache);
+        else
+          analyse_file(file, opt, p, recovery, tokens);
+      });
+
+    for (const auto& file: files)
+      lint(file);
+    if (not opt.files_from.empty())
+      for_each_listed_file(opt.files_from, lint);
+  }
+  sink.end(std::cout);
+  stats.print_summary(message_stream(opt));
+
+  return sink.failed() or unformatted_files() ? 1 : 0;
+}
+
+
+/*
+ *  Handle one client invocation, in the state prepared by serve.
+ */
+int serve_request(const std::vector<std::string>& arguments, bool terminal,
+                  alint_context& context) {
+  try {
+    options opt;
+    std::vector<std::string> files;
+    parse_arguments(arguments, opt, files);
+    opt.colors = terminal;
+    if (opt.server or opt.client or opt.watch or opt.language_server)
+      throw std::string("error: option not available through the server.");
+
+    /*
+     *  A request is traced in its own file, unless the server itself
+     *  is traced.
+     */
+    const bool traced(not opt.trace.empty() and not default_trace().is_enabled());
+    if (traced)
+      default_trace().open(opt.trace);
+    int status(1);
+    try {
+      status = run(opt, files, context, true);
+    }
+    catch (...) {
+      if (traced)
+        default_trace().close();
+      throw;
+    }
+    if (traced)
+      default_trace().close();
+    return status;
   }
   catch (const std::string& e) {
     std::cout << e << std::endl;
+    return 1;
   }
 }
 
+
 int main(int argc, char *argv[]) {
   try {
     options opt;
 
+    const std::vector<std::string> arguments(argv + 1, argv + argc);
     std::vector<std::string> files;
-    for (int i(1); i < argc; ++i) {
-      if (argv[i][0] != '-') {
-	files.push_back(argv[i]);
-      } else {
-	if (std::string(argv[i]).size() != 2)
-	  throw std::string("unrecognize option: ") + argv[i];
-
-	switch (argv[i][1]) {
-	case 'l':
-	  opt.lexing_pass = true;
-	  opt.parsing_pass = false;
-	  break;
-	case 'v':
-	  opt.verbose = true;
-	  break;
-        case 'd':
-          opt.show_dependencies = true;
-          break;
-        case 'c':
-          opt.run_checkers = true;
-          break;
-	case 's':
-	  opt.silent = true;
-	  break;
-	case 'f':
-	  opt.reformat_source = true;
-	  break;
-	case 'r':
-	  opt.recursive_parse = true;
-	  break;
-	case 'g':
-	  opt.show_grammar = true;
-	  break;
-        case 'h':
-          opt.html_highlight = true;
-          break;
-	default:
-	  throw std::string("unrecognize option: ") + argv[i];
-	}
+    parse_arguments(arguments, opt, files);
+    opt.colors = isatty(1);
+
+    if (opt.client) {
+      /*
+       *  The server can't read the standard input of the client: the
+       *  listed files are sent as arguments instead.
+       */
+      std::vector<std::string> forwarded;
+      for (const auto& a: arguments) {
+        if (a == "--files-from=-")
+          for_each_listed_file("-", [&](const std::string& f) {
+              forwarded.push_back(f);
+            });
+        else if (a.compare(0, 8, "--client") != 0)
+          forwarded.push_back(a);
       }
+      return run_client(opt.socket_path, forwarded);
     }
 
-    if (files.empty())
-      throw std::string("wrong number of arguments.");
+    if (not opt.trace.empty())
+      default_trace().open(opt.trace);
 
-    cf_grammar<symbol> g(build_cf_grammar());
-    lr_parser<symbol> p(g);
-    
-    if (opt.show_grammar)
-      p.print(std::cout, g);
+    alint_context context;
 
-    alint_token_source tokens;
-    for (const auto& file: files) {
-      analyse_file(file, opt, p, g, tokens);
+    if (opt.server) {
+      serve(opt.socket_path, [&](const std::vector<std::string>& request, bool terminal) {
+          return serve_request(request, terminal, context);
+        });
+      return 0;
     }
+
+    return run(opt, files, context, false);
   }
   catch (const std::string& e) {
     std::cout << e << std::endl;
@@ -0,0 +1,68 @@
+#ifndef ALLOCATIONS_H
+#define ALLOCATIONS_H
+
+#include <atomic>
+#include <cstdint>
+
+#include <malloc.h>
+
+
+/*
+ *  Counters of the heap allocations of all the threads, updated by the
+ *  operator new and delete of alint while counting is enabled. The
+ *  sizes are the usable sizes of the blocks, so that a deallocation
+ *  takes back exactly what its allocation counted.
+ */
+struct allocation_counters {
+  std::atomic<bool> enabled;
+  std::atomic<std::uint64_t> count;
+  std::atomic<std::uint64_t> bytes;
+  std::atomic<std::int64_t> live;
+  std::atomic<std::int64_t> peak;
+};
+
+
+inline
+allocation_counters& global_allocations() {
+  static allocation_counters counters = { {false}, {0}, {0}, {0}, {0} };
+  return counters;
+}
+
+
+inline
+void record_allocation(void* p) {
+  allocation_counters& c(global_allocations());
+  if (not c.enabled.load(std::memory_order_relaxed))
+    return;
+
+  const std::int64_t size(malloc_usable_size(p));
+  c.count.fetch_add(1, std::memory_order_relaxed);
+  c.bytes.fetch_add(size, std::memory_order_relaxed);
+  const std::int64_t live(c.live.fetch_add(size, std::memory_order_relaxed) + size);
+  std::int64_t peak(c.peak.load(std::memory_order_relaxed));
+  while (live > peak and not c.peak.compare_exchange_weak(peak, live, std::memory_order_relaxed)) {}
+}
+
+
+inline
+void record_deallocation(void* p) {
+  allocation_counters& c(global_allocations());
+  if (c.enabled.load(std::memory_order_relaxed))
+    c.live.fetch_sub(malloc_usable_size(p), std::memory_order_relaxed);
+}
+
+
+/*
+ *  The allocation count and bytes at some point, to be subtracted
+ *  from a later one.
+ */
+struct allocation_snapshot {
+  allocation_snapshot()
+    : count(global_allocations().count.load(std::memory_order_relaxed)),
+      bytes(global_allocations().bytes.load(std::memory_order_relaxed)) {}
+
+  std::uint64_t count;
+  std::uint64_t bytes;
+};
+
+#endif /* ALLOCATIONS_H */
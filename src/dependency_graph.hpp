@@ -0,0 +1,345 @@
+#ifndef DEPENDENCY_GRAPH_H
+#define DEPENDENCY_GRAPH_H
+
+#include <map>
+#include <set>
+#include <stack>
+#include <string>
+#include <vector>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+#include <cstdint>
+#include <cstdio>
+
+#include "file_utils.hpp"
+
+
+/*
+ *  Persistent index of the @input, local macro and global macro edges
+ *  of a macro tree.
+ *
+ *  Each file record remembers the modification time and the content
+ *  hash of the file at the time its edges were extracted: an update
+ *  only stats the known files, hashes the ones whose modification time
+ *  changed, and parses the ones whose content changed. The reverse
+ *  edges are maintained alongside, so that the transitive dependents
+ *  of a file are found by a walk of the in-memory graph.
+ *
+ *  File names are canonicalized before being used as keys, such that
+ *  a file reached through an @input and through a macro directory is
+ *  recorded once.
+ */
+class dependency_graph {
+public:
+  struct file_record {
+    file_record(): mtime(0), hash(0), analysis_time(0.0) {}
+
+    std::int64_t mtime;
+    std::uint64_t hash;
+    double analysis_time;  // seconds spent by the last lint of the file
+    dependency_list dependencies;
+  };
+
+  dependency_graph(): dirty(false) {}
+
+  void load(const std::string& filename) {
+    std::ifstream file(filename.c_str(), std::ios::in);
+    if (not file)
+      return;
+
+    std::string line;
+    std::getline(file, line);
+    if (line != header())
+      throw std::string("error: ") + filename + " is not an alint dependency index.";
+
+    file_record current;
+    bool has_current(false);
+    std::string current_name;
+    while (std::getline(file, line)) {
+      std::istringstream fields(line);
+      std::string type;
+      std::getline(fields, type, '\t');
+
+      if (type == "file") {
+        if (has_current)
+          set_record(current_name, current);
+        current = file_record();
+        has_current = true;
+
+        std::string mtime, hash, analysis_time;
+        std::getline(fields, current_name, '\t');
+        std::getline(fields, mtime, '\t');
+        std::getline(fields, hash, '\t');
+        std::getline(fields, analysis_time, '\t');
+        try {
+          current.mtime = std::stoll(mtime);
+          current.hash = std::stoull(hash);
+          if (not analysis_time.empty())
+            current.analysis_time = std::stod(analysis_time);
+        }
+        catch (const std::logic_error&) {
+          throw std::string("error: ") + filename + ": malformed dependency index.";
+        }
+      } else if (type == "dep" and has_current) {
+        std::string kind, name;
+        std::getline(fields, kind, '\t');
+        std::getline(fields, name, '\t');
+        current.dependencies.insert(std::make_pair(name, parse_kind(kind)));
+      } else {
+        throw std::string("error: ") + filename + ": malformed dependency index.";
+      }
+    }
+
+    if (has_current)
+      set_record(current_name, current);
+
+    dirty = false;
+  }
+
+  void save(const std::string& filename) {
+    if (not dirty)
+      return;
+
+    const std::string temporary(filename + ".tmp");
+    {
+      std::ofstream file(temporary.c_str(), std::ios::out | std::ios::trunc);
+      if (not file)
+        throw std::string("could not open ") + temporary;
+
+      file << header() << '\n';
+      for (const auto& f: files) {
+        file << "file\t" << f.first << '\t'
+             << f.second.mtime << '\t' << f.second.hash << '\t'
+             << f.second.analysis_time << '\n';
+        for (const auto& d: f.second.dependencies)
+          file << "dep\t" << d.second << '\t' << d.first << '\n';
+      }
+
+      if (not file)
+        throw std::string("could not write ") + temporary;
+    }
+
+    if (std::rename(temporary.c_str(), filename.c_str()) != 0)
+      throw std::string("could not write ") + filename;
+
+    dirty = false;
+  }
+
+  /*
+   *  Bring the records of the roots and of everything they
+   *  transitively depend on up to date. extract(filename) must return
+   *  the dependency_list of the file. Returns the number of files
+   *  which have been parsed.
+   */
+  template<typename extractor_type>
+  std::size_t update(const std::vector<std::string>& roots,
+                     extractor_type extract) {
+    std::size_t parsed(0);
+    std::set<std::string> visited;
+    std::stack<std::string> unvisited;
+    for (const auto& r: roots)
+      unvisited.push(canonical_path(r));
+
+    while (unvisited.size()) {
+      const std::string f(unvisited.top());
+      unvisited.pop();
+      if (not visited.insert(f).second)
+        continue;
+
+      if (refresh_record(f, extract))
+        ++parsed;
+
+      for (const auto& d: files[f].dependencies)
+        if (visited.count(d.first) == 0)
+          unvisited.push(d.first);
+    }
+
+    return parsed;
+  }
+
+  /*
+   *  Bring every known record up to date, and follow the new edges.
+   */
+  template<typename extractor_type>
+  std::size_t update(extractor_type extract) {
+    std::vector<std::string> roots;
+    for (const auto& f: files)
+      roots.push_back(f.first);
+
+    return update(roots, extract);
+  }
+
+  /*
+   *  Forget a file, e.g. because it has been removed from the tree.
+   */
+  void remove(const std::string& filename) {
+    const std::string f(canonical_path(filename));
+    if (files.count(f)) {
+      set_dependencies(f, dependency_list());
+      files.erase(f);
+      dirty = true;
+    }
+  }
+
+  /*
+   *  Every file which transitively includes, or calls a macro
+   *  defined in, the given file.
+   */
+  std::set<std::string> get_reverse_dependencies(const std::string& filename) const {
+    return get_reverse_dependencies(std::set<std::string>{filename});
+  }
+
+  std::set<std::string> get_reverse_dependencies(const std::set<std::string>& filenames) const {
+    std::set<std::string> result;
+    std::stack<std::string> unvisited;
+    for (const auto& f: filenames)
+      unvisited.push(canonical_path(f));
+
+    while (unvisited.size()) {
+      const std::string f(unvisited.top());
+      unvisited.pop();
+
+      const auto item(reverse_edges.find(f));
+      if (item == reverse_edges.end())
+        continue;
+
+      for (const auto& r: item->second)
+        if (result.insert(r).second)
+          unvisited.push(r);
+    }
+
+    return result;
+  }
+
+  /*
+   *  The files which directly include, or call a macro defined in, the
+   *  given file.
+   */
+  const std::set<std::string>& get_dependents(const std::string& filename) const {
+    static const std::set<std::string> empty;
+    const auto item(reverse_edges.find(canonical_path(filename)));
+    return item == reverse_edges.end() ? empty : item->second;
+  }
+
+  const dependency_list& get_dependencies(const std::string& filename) const {
+    static const dependency_list empty;
+    const auto item(files.find(canonical_path(filename)));
+    return item == files.end() ? empty : item->second.dependencies;
+  }
+
+  void set_analysis_time(const std::string& filename, double seconds) {
+    files[canonical_path(filename)].analysis_time = seconds;
+    dirty = true;
+  }
+
+  /*
+   *  Estimated time of a lint of every known file, based on the
+   *  recorded analysis times. Files which have never been linted are
+   *  accounted for with their size and the throughput measured on the
+   *  others. unestimated is the number of files left out, when there
+   *  is no throughput to go by.
+   */
+  double get_full_analysis_time(std::size_t& unestimated) const {
+    double total(0.0);
+    std::uint64_t measured_bytes(0);
+    std::vector<std::string> unknown;
+    for (const auto& f: files)
+      if (f.second.mtime) {
+        if (f.second.analysis_time > 0.0) {
+          total += f.second.analysis_time;
+          measured_bytes += get_file_size(f.first);
+        } else
+          unknown.push_back(f.first);
+      }
+
+    unestimated = 0;
+    if (measured_bytes == 0) {
+      unestimated = unknown.size();
+      return total;
+    }
+
+    const double seconds_per_byte(total / measured_bytes);
+    for (const auto& f: unknown)
+      total += get_file_size(f) * seconds_per_byte;
+    return total;
+  }
+
+  bool contains(const std::string& filename) const {
+    return files.count(canonical_path(filename));
+  }
+
+  const std::map<std::string, file_record>& get_files() const { return files; }
+
+private:
+  static const char* header() { return "alint dependency index 1"; }
+
+  std::map<std::string, file_record> files;
+  std::map<std::string, std::set<std::string> > reverse_edges;
+  bool dirty;
+
+  static dependency_kind parse_kind(const std::string& kind) {
+    if (kind == "input")
+      return dependency_kind::input;
+    else if (kind == "local_macro")
+      return dependency_kind::local_macro;
+    else if (kind == "global_macro")
+      return dependency_kind::global_macro;
+    throw std::string("error: unknown dependency kind ") + kind;
+  }
+
+  /*
+   *  Returns true if the file had to be parsed.
+   */
+  template<typename extractor_type>
+  bool refresh_record(const std::string& filename, extractor_type& extract) {
+    const bool known(files.count(filename));
+    file_record& record(files[filename]);
+    const std::int64_t mtime(get_modification_time(filename));
+    if (known and mtime == record.mtime)
+      return false;
+
+    dirty = true;
+    record.mtime = mtime;
+    if (mtime == 0) {
+      // the file has disappeared, or never existed
+      record.hash = 0;
+      set_dependencies(filename, dependency_list());
+      return false;
+    }
+
+    const std::uint64_t hash(hash_file_content(filename));
+    if (hash == record.hash)
+      return false;
+
+    record.hash = hash;
+    dependency_list canonical_dependencies;
+    for (const auto& d: extract(filename))
+      canonical_dependencies.insert(std::make_pair(canonical_path(d.first), d.second));
+    set_dependencies(filename, canonical_dependencies);
+    return true;
+  }
+
+  void set_record(const std::string& filename, const file_record& record) {
+    files[filename].mtime = record.mtime;
+    files[filename].hash = record.hash;
+    files[filename].analysis_time = record.analysis_time;
+    set_dependencies(filename, record.dependencies);
+  }
+
+  void set_dependencies(const std::string& filename, const dependency_list& dependencies) {
+    file_record& record(files[filename]);
+    for (const auto& d: record.dependencies) {
+      auto& r(reverse_edges[d.first]);
+      r.erase(filename);
+      if (r.empty())
+        reverse_edges.erase(d.first);
+    }
+
+    record.dependencies = dependencies;
+    for (const auto& d: record.dependencies)
+      reverse_edges[d.first].insert(filename);
+  }
+};
+
+#endif /* DEPENDENCY_GRAPH_H */
@@ -0,0 +1,344 @@
+#ifndef DIAGNOSTICS_H
+#define DIAGNOSTICS_H
+
+#include <string>
+#include <vector>
+#include <fstream>
+#include <sstream>
+#include <ostream>
+#include <algorithm>
+#include <mutex>
+#include <map>
+#include <atomic>
+#include <cstddef>
+
+#include <unistd.h>
+
+#include <spikes/ansi_iomanip.hpp>
+
+#include "json.hpp"
+
+
+struct diagnostic {
+  diagnostic(const std::string& filename,
+             std::size_t line, std::size_t column,
+             const std::string& severity,
+             const std::string& message,
+             const std::string& rule = "",
+             const std::string& location = "")
+    : filename(filename), line(line), column(column),
+      severity(severity), message(message), rule(rule), location(location) {}
+
+  std::string filename;
+  std::size_t line;
+  std::size_t column;
+  std::string severity;
+  std::string message;
+  std::string rule;
+
+  /*
+   *  The coordinates as the lexer renders them, if not the default
+   *  filename:line:column.
+   */
+  std::string location;
+};
+
+
+/*
+ *  When set, the warnings and the lexing errors of the current thread
+ *  are appended to this list instead of being printed.
+ */
+inline
+std::vector<diagnostic>*& diagnostic_collector() {
+  static thread_local std::vector<diagnostic>* collector(nullptr);
+  return collector;
+}
+
+
+enum class output_format {
+  text, json, sarif
+};
+
+
+/*
+ *  Collects the diagnostics reported by any thread, and prints them on
+ *  flush, sorted by file and position.
+ *
+ *  As text, each one is followed by the source line it refers to;
+ *  each file is read once, and the output is written at once. As
+ *  json, each diagnostic is a JSON object on its own line. As sarif,
+ *  they are the results of a SARIF 2.1.0 log, opened by begin and
+ *  closed by end. In both cases the records are written at each flush,
+ *  and the dependency edges as soon as they are given.
+ */
+class diagnostic_sink {
+public:
+  diagnostic_sink()
+    : colors(isatty(1)), format(output_format::text), results(0),
+      max_diagnostics(0), fail_fast(false), has_failed(false) {}
+
+  void set_format(output_format f) { format = f; }
+  output_format get_format() const { return format; }
+
+  void set_colors(bool c) { colors = c; }
+
+  /*
+   *  At most max reports per file, 0 for no limit: the one after the
+   *  last says so, the next ones are dropped.
+   */
+  void set_max_diagnostics(std::size_t max) { max_diagnostics = max; }
+
+  /*
+   *  With fail fast, the first error marks the run as failed, and the
+   *  work still to be done is cancelled.
+   */
+  void set_fail_fast(bool f) { fail_fast = f; }
+  bool failed() const { return has_failed.load(std::memory_order_relaxed); }
+
+  void begin(std::ostream& stream) {
+    results = 0;
+    has_failed = false;
+    counts.clear();
+    if (format == output_format::sarif)
+      stream << "{\"version\":\"2.1.0\","
+             << "\"$schema\":\"https://json.schemastore.org/sarif-2.1.0.json\","
+             << "\"runs\":[{\"tool\":{\"driver\":{\"name\":\"alint\"}},\"results\":[\n";
+  }
+
+  void end(std::ostream& stream) {
+    flush(stream);
+    if (format == output_format::sarif)
+      stream << "\n]}]}" << std::endl;
+  }
+
+  void add(const diagnostic& d) {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (fail_fast and d.severity == "error")
+      has_failed = true;
+
+    if (max_diagnostics) {
+      std::size_t& count(counts[d.filename]);
+      if (count > max_diagnostics)
+        return;
+      if (count++ == max_diagnostics) {
+        pending.push_back(diagnostic(d.filename, d.line, d.column, "error",
+                                     "too many diagnostics, the next ones are not reported.",
+                                     "resource-limit", d.location));
+        return;
+      }
+    }
+    pending.push_back(d);
+  }
+
+  /*
+   *  The file depends on dependency, of the given kind: input,
+   *  local_macro or global_macro.
+   */
+  void add_dependency(std::ostream& stream, const std::string& file,
+                      const std::string& dependency, const std::string& kind) {
+    std::ostringstream output;
+    if (format == output_format::json) {
+      output << "{\"type\":\"dependency\",\"file\":\"" << json_escape(file)
+             << "\",\"dependency\":\"" << json_escape(dependency)
+             << "\",\"kind\":\"" << kind << "\"}\n";
+    } else {
+      output << "{\"ruleId\":\"dependency\",\"kind\":\"informational\",\"level\":\"none\","
+             << "\"message\":{\"text\":\"" << json_escape(file + " depends on " + dependency) << "\"},"
+             << "\"locations\":[{\"physicalLocation\":{\"artifactLocation\":{\"uri\":\""
+             << json_escape(sarif_uri(file)) << "\"}}}],"
+             << "\"properties\":{\"dependency\":\"" << json_escape(dependency)
+             << "\",\"dependencyKind\":\"" << kind << "\"}}";
+    }
+
+    std::lock_guard<std::mutex> lock(mutex);
+    write_record(stream, output.str());
+  }
+
+  void flush(std::ostream& stream) {
+    std::vector<diagnostic> sorted;
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      sorted.swap(pending);
+    }
+    if (sorted.empty())
+      return;
+
+    std::stable_sort(sorted.begin(), sorted.end(), [](const diagnostic& a, const diagnostic& b) {
+        if (a.filename != b.filename)
+          return a.filename < b.filename;
+        if (a.line != b.line)
+          return a.line < b.line;
+        return a.column < b.column;
+      });
+
+    if (format == output_format::text) {
+      write_text(stream, sorted);
+      return;
+    }
+
+    std::lock_guard<std::mutex> lock(mutex);
+    for (std::size_t i(0); i < sorted.size(); ++i)
+      if (i == 0 or sorted[i].filename != sorted[i - 1].filename
+          or not same_report(sorted[i], sorted[i - 1]))
+        write_record(stream, render_record(sorted[i]));
+    stream.flush();
+  }
+
+private:
+  std::mutex mutex;
+  std::vector<diagnostic> pending;
+  bool colors;
+  output_format format;
+  std::size_t results;
+  std::size_t max_diagnostics;
+  std::map<std::string, std::size_t> counts;
+  bool fail_fast;
+  std::atomic<bool> has_failed;
+
+  void write_text(std::ostream& stream, const std::vector<diagnostic>& sorted) const {
+    std::ostringstream output;
+    std::vector<std::string> lines;
+    bool readable(false), first_of_file(false);
+    for (std::size_t i(0); i < sorted.size(); ++i) {
+      const diagnostic& d(sorted[i]);
+      first_of_file = i == 0 or d.filename != sorted[i - 1].filename;
+      if (not first_of_file and same_report(d, sorted[i - 1]))
+        continue;
+
+      if (first_of_file) {
+        std::size_t last(i);
+        while (last + 1 < sorted.size() and sorted[last + 1].filename == d.filename)
+          ++last;
+        readable = read_lines(d.filename, sorted[last].line, lines);
+      }
+
+      if (d.location.empty())
+        output << d.filename << ':' << d.line << ':' << d.column;
+      else
+        output << d.location;
+
+      output << ' ';
+      if (colors)
+        output << ansi::bold << ansi::color(d.severity == "warning" ? 208 : 160)
+               << d.severity << ansi::normal;
+      else
+        output << d.severity;
+      output << ": " << d.message << '\n';
+
+      if (not readable) {
+        if (first_of_file)
+          output << "could not open " << d.filename << '\n';
+      }
+      else if (d.line >= 1 and d.line <= lines.size())
+        write_excerpt(output, lines[d.line - 1], d.column);
+    }
+
+    const std::string text(output.str());
+    stream.write(text.data(), text.size());
+    stream.flush();
+  }
+
+  /*
+   *  The source line under a diagnostic, with a caret at its column.
+   *  Of a long line, only the characters around the column are shown:
+   *  otherwise each of many errors on a huge line, as in a binary
+   *  file, would print all of it.
+   */
+  static void write_excerpt(std::ostream& output, const std::string& line, std::size_t column) {
+    const std::size_t width(80);
+    if (line.size() <= 2 * width) {
+      output << line << '\n' << std::string(column, ' ') << "^ here\n";
+      return;
+    }
+
+    column = std::min(column, line.size());
+    const std::size_t first(column > width ? column - width : 0);
+    const std::size_t last(std::min(line.size(), column + width));
+    const std::string before(first > 0 ? "..." : "");
+    output << before << line.substr(first, last - first) << (last < line.size() ? "..." : "") << '\n'
+           << std::string(before.size() + column - first, ' ') << "^ here\n";
+  }
+
+  /*
+   *  The lines are numbered from 1 and the columns from 0, as in the
+   *  text output; SARIF numbers both from 1.
+   */
+  std::string render_record(const diagnostic& d) const {
+    std::ostringstream output;
+    if (format == output_format::json) {
+      output << "{\"type\":\"diagnostic\",\"file\":\"" << json_escape(d.filename)
+             << "\",\"line\":" << d.line << ",\"column\":" << d.column
+             << ",\"rule\":\"" << json_escape(d.rule)
+             << "\",\"severity\":\"" << d.severity
+             << "\",\"message\":\"" << json_escape(d.message) << "\"}\n";
+    } else {
+      output << "{\"ruleId\":\"" << json_escape(d.rule) << "\",\"level\":\"" << d.severity << "\","
+             << "\"message\":{\"text\":\"" << json_escape(d.message) << "\"},"
+             << "\"locations\":[{\"physicalLocation\":{\"artifactLocation\":{\"uri\":\""
+             << json_escape(sarif_uri(d.filename)) << "\"}";
+      if (d.line >= 1)
+        output << ",\"region\":{\"startLine\":" << d.line << ",\"startColumn\":" << d.column + 1 << "}";
+      output << "}}]}";
+    }
+    return output.str();
+  }
+
+  /*
+   *  SARIF results are separated by commas.
+   */
+  void write_record(std::ostream& stream, const std::string& record) {
+    if (format == output_format::sarif and results)
+      stream << ",\n";
+    stream << record;
+    ++results;
+  }
+
+  static std::string sarif_uri(const std::string& filename) {
+    return filename.size() and filename[0] == '/' ? "file://" + filename : filename;
+  }
+
+  /*
+   *  A parse error is reported by the error handler and again by the
+   *  caller catching it: identical reports are printed once.
+   */
+  static bool same_report(const diagnostic& a, const diagnostic& b) {
+    return a.line == b.line and a.column == b.column
+      and a.severity == b.severity and a.message == b.message;
+  }
+
+  /*
+   *  The first count lines of a file.
+   */
+  static bool read_lines(const std::string& filename, std::size_t count,
+                         std::vector<std::string>& lines) {
+    lines.clear();
+    std::ifstream file(filename.c_str(), std::ios::in);
+    if (not file)
+      return false;
+
+    std::string line;
+    while (lines.size() < count and std::getline(file, line))
+      lines.push_back(line);
+    return true;
+  }
+};
+
+inline
+diagnostic_sink& default_diagnostic_sink() {
+  static diagnostic_sink sink;
+  return sink;
+}
+
+/*
+ *  Give a diagnostic to the collector of the thread, or else to the
+ *  default sink.
+ */
+inline
+void report_diagnostic(const diagnostic& d) {
+  if (diagnostic_collector())
+    diagnostic_collector()->push_back(d);
+  else
+    default_diagnostic_sink().add(d);
+}
+
+#endif /* DIAGNOSTICS_H */
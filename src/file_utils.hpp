@@ -2,25 +2,184 @@
 #define FILE_UTILS_H
 
 #include <string>
+#include <vector>
 #include <fstream>
+#include <sstream>
 #include <iostream>
+#include <cstdint>
+#include <cstdlib>
+#include <cstdio>
+#include <cerrno>
+
+#include <sys/stat.h>
+#include <unistd.h>
+
+inline
+std::int64_t get_modification_time(const std::string& filename) {
+  struct stat s;
+  if (stat(filename.c_str(), &s) != 0)
+    return 0;
+
+  return static_cast<std::int64_t>(s.st_mtim.tv_sec) * 1000000000
+    + s.st_mtim.tv_nsec;
+}
 
 inline
-void show_coordinates_in_file(const std::string& filename,
-                              std::size_t line_number,
-                              std::size_t column_number) {
-  std::ifstream file(filename.c_str(), std::ios::in);
+std::uint64_t get_file_size(const std::string& filename) {
+  struct stat s;
+  if (stat(filename.c_str(), &s) != 0)
+    return 0;
+
+  return static_cast<std::uint64_t>(s.st_size);
+}
+
+/*
+ *  64 bits FNV-1a hash of the file content, returns 0 if the file
+ *  can't be read.
+ */
+inline
+std::uint64_t hash_file_content(const std::string& filename) {
+  std::ifstream file(filename.c_str(), std::ios::in | std::ios::binary);
   if (not file)
-    throw std::string("could not open ") + filename;
-  
-  std::string line;
-  while (line_number > 0) {
-    std::getline(file, line);
-    --line_number;
+    return 0;
+
+  std::uint64_t hash(14695981039346656037ull);
+  char buffer[65536];
+  while (file.read(buffer, sizeof(buffer)) or file.gcount()) {
+    const std::streamsize n(file.gcount());
+    for (std::streamsize i(0); i < n; ++i) {
+      hash ^= static_cast<unsigned char>(buffer[i]);
+      hash *= 1099511628211ull;
+    }
   }
 
-  std::cout << line << std::endl;
-  std::cout << std::string(column_number, ' ') << "^ here" << std::endl;
+  return hash;
+}
+
+/*
+ *  The whole content of a file, throws if it can't be read.
+ */
+inline
+std::string read_file(const std::string& filename) {
+  std::ifstream file(filename.c_str(), std::ios::in | std::ios::binary);
+  if (not file)
+    throw std::string("could not read ") + filename;
+  std::ostringstream content;
+  content << file.rdbuf();
+  return content.str();
+}
+
+inline
+std::string canonical_path(const std::string& filename) {
+  char* path(realpath(filename.c_str(), nullptr));
+  if (not path)
+    return filename;
+
+  const std::string result(path);
+  std::free(path);
+  return result;
+}
+
+/*
+ *  Replace the content of a file, through a temporary file in the same
+ *  directory renamed over it: the file has either its old or its new
+ *  content, even if the process is interrupted. The permissions of
+ *  the file are kept. A symbolic link is followed, so that the file it
+ *  points to is replaced and the link kept.
+ */
+inline
+void write_file_atomically(const std::string& link, const std::string& content) {
+  const std::string filename(canonical_path(link));
+  std::string temporary(filename + ".alint-XXXXXX");
+  const int fd(mkstemp(&temporary[0]));
+  if (fd < 0)
+    throw std::string("could not create a temporary file for ") + filename;
+
+  struct stat s;
+  bool written(stat(filename.c_str(), &s) != 0 or fchmod(fd, s.st_mode & 07777) == 0);
+  for (std::size_t offset(0); written and offset < content.size();) {
+    const ssize_t n(write(fd, content.data() + offset, content.size() - offset));
+    written = n > 0;
+    offset += written ? n : 0;
+  }
+  written = fsync(fd) == 0 and written;
+  written = close(fd) == 0 and written;
+
+  if (not written or std::rename(temporary.c_str(), filename.c_str()) != 0) {
+    std::remove(temporary.c_str());
+    throw std::string("could not write ") + filename;
+  }
+}
+
+/*
+ *  Replace the content of a file, or create it, directly.
+ */
+inline
+void write_file(const std::string& filename, const std::string& content) {
+  std::ofstream file(filename.c_str(), std::ios::out | std::ios::trunc | std::ios::binary);
+  if (not file.write(content.data(), content.size()))
+    throw std::string("could not write ") + filename;
+}
+
+/*
+ *  Create the directories of a path which do not exist, as mkdir -p.
+ */
+inline
+void make_directories(const std::string& path) {
+  for (std::string::size_type slash(path.find('/', 1));; slash = path.find('/', slash + 1)) {
+    const std::string directory(path.substr(0, slash));
+    if (mkdir(directory.c_str(), 0777) != 0 and errno != EEXIST)
+      throw std::string("could not create the directory ") + directory;
+    if (slash == std::string::npos)
+      return;
+  }
+}
+
+inline
+bool is_macro_file(const std::string& filename) {
+  const std::string extension(".mac");
+  return filename.size() >= extension.size()
+    and filename.compare(filename.size() - extension.size(),
+                         extension.size(), extension) == 0;
+}
+
+/*
+ *  Call f on each path of a list, read from a file or from the
+ *  standard input when list_path is "-". The paths are separated by
+ *  NUL characters, as find -print0 gives them, or by newlines if the
+ *  first path ends with a newline. Empty paths are skipped.
+ */
+template<typename function_type>
+void for_each_listed_file(const std::string& list_path, function_type f) {
+  std::ifstream file;
+  if (list_path != "-") {
+    file.open(list_path.c_str(), std::ios::in | std::ios::binary);
+    if (not file)
+      throw std::string("error: could not open ") + list_path;
+  }
+  std::istream& list(list_path == "-" ? std::cin : file);
+
+  int separator(-1);
+  std::string path;
+  auto flush([&]() {
+      if (separator == '\n' and not path.empty() and path.back() == '\r')
+        path.pop_back();
+      if (not path.empty())
+        f(path);
+      path.clear();
+    });
+
+  char c;
+  while (list.get(c)) {
+    if (c == '\0' or (c == '\n' and separator != '\0')) {
+      if (separator == -1)
+        separator = c;
+      flush();
+    } else {
+      path.push_back(c);
+    }
+  }
+  flush();
 }
 
 #endif /* FILE_UTILS_H */
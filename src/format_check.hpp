@@ -0,0 +1,114 @@
+#ifndef FORMAT_CHECK_H
+#define FORMAT_CHECK_H
+
+#include <string>
+#include <streambuf>
+#include <algorithm>
+#include <atomic>
+
+#include "file_utils.hpp"
+
+
+/*
+ *  Thrown by format_comparer at the first character which differs from
+ *  the source.
+ */
+struct format_difference {};
+
+
+/*
+ *  Output buffer comparing the characters written to it with those of
+ *  a source text, instead of storing them.
+ */
+class format_comparer: public std::streambuf {
+public:
+  format_comparer(const std::string& source): source(source), position(0) {}
+
+  std::size_t get_position() const { return position; }
+
+protected:
+  virtual int_type overflow(int_type c) override {
+    if (traits_type::eq_int_type(c, traits_type::eof()))
+      return traits_type::not_eof(c);
+
+    if (position == source.size() or source[position] != traits_type::to_char_type(c))
+      throw format_difference();
+    ++position;
+    return c;
+  }
+
+  virtual std::streamsize xsputn(const char* s, std::streamsize n) override {
+    const std::size_t size(n);
+    const std::size_t available(std::min(size, source.size() - position));
+    const char* first(source.data() + position);
+    const std::size_t same(std::mismatch(s, s + available, first).first - s);
+    position += same;
+    if (same < size)
+      throw format_difference();
+    return n;
+  }
+
+private:
+  const std::string& source;
+  std::size_t position;
+};
+
+
+/*
+ *  The offset of the first difference between the source and its
+ *  reformatted tree, or std::string::npos if there is none. The
+ *  reformatting stops at the difference. The white spaces at the end
+ *  of the source, which the reformatting drops, are not a difference.
+ */
+std::size_t find_format_difference(basic_node* tree,
+                                   const std::vector<std::string>& white_spaces,
+                                   const std::string& source) {
+  format_comparer comparer(source);
+  std::ostream stream(&comparer);
+  stream.exceptions(std::ios::badbit);
+  try {
+    reformat(tree, white_spaces, stream);
+  }
+  catch (const format_difference&) {
+    return comparer.get_position();
+  }
+
+  if (source.find_first_not_of(" \t\n\r", comparer.get_position()) != std::string::npos)
+    return comparer.get_position();
+  return std::string::npos;
+}
+
+
+/*
+ *  The number of files found not formatted since the last reset.
+ */
+inline
+std::atomic<std::size_t>& unformatted_files() {
+  static std::atomic<std::size_t> count(0);
+  return count;
+}
+
+
+/*
+ *  Report the first line of the file which the reformatting changes,
+ *  if any.
+ */
+void check_format(const std::string& filename, basic_node* tree,
+                  const std::vector<std::string>& white_spaces) {
+  const std::string source(read_file(filename));
+
+  const std::size_t difference(find_format_difference(tree, white_spaces, source));
+  if (difference == std::string::npos)
+    return;
+
+  const std::size_t line(std::count(source.begin(), source.begin() + difference, '\n') + 1);
+  const std::size_t line_start(source.rfind('\n', difference ? difference - 1 : 0));
+  const std::size_t column(line_start == std::string::npos or difference == 0
+                           ? difference : difference - line_start - 1);
+  report_diagnostic(diagnostic(filename, line, column, "error",
+                               "not formatted, the reformatted file differs from here.",
+                               "format"));
+  ++unformatted_files();
+}
+
+#endif /* FORMAT_CHECK_H */
@@ -0,0 +1,70 @@
+#ifndef GIT_CHANGES_H
+#define GIT_CHANGES_H
+
+#include <set>
+#include <string>
+#include <cstdio>
+
+#include "file_utils.hpp"
+
+
+inline
+std::string shell_quote(const std::string& s) {
+  std::string result("'");
+  for (const auto c: s)
+    if (c == '\'')
+      result += "'\\''";
+    else
+      result += c;
+  return result + "'";
+}
+
+/*
+ *  Run a shell command and return its standard output.
+ */
+inline
+std::string read_command_output(const std::string& command) {
+  FILE* pipe(popen(command.c_str(), "r"));
+  if (not pipe)
+    throw std::string("error: could not run ") + command;
+
+  std::string output;
+  char buffer[4096];
+  std::size_t n;
+  while ((n = std::fread(buffer, 1, sizeof(buffer), pipe)) > 0)
+    output.append(buffer, n);
+
+  if (pclose(pipe) != 0)
+    throw std::string("error: command failed: ") + command;
+
+  return output;
+}
+
+/*
+ *  Canonical names of the files which differ between two revisions of
+ *  the git repository containing the current directory. The revisions
+ *  are given the way git diff accepts them: "a..b", or a single
+ *  revision to compare with the working tree.
+ */
+inline
+std::set<std::string> get_changed_files(const std::string& revisions) {
+  std::string top_level(read_command_output("git rev-parse --show-toplevel"));
+  while (not top_level.empty() and top_level.back() == '\n')
+    top_level.pop_back();
+
+  const std::string output(read_command_output("git diff --name-only -z "
+                                               + shell_quote(revisions)
+                                               + " --"));
+
+  std::set<std::string> files;
+  std::string::size_type begin(0), end;
+  while ((end = output.find('\0', begin)) != std::string::npos) {
+    if (end > begin)
+      files.insert(canonical_path(top_level + "/" + output.substr(begin, end - begin)));
+    begin = end + 1;
+  }
+
+  return files;
+}
+
+#endif /* GIT_CHANGES_H */
@@ -0,0 +1,525 @@
+#ifndef INCREMENTAL_H
+#define INCREMENTAL_H
+
+#include <string>
+#include <vector>
+#include <istream>
+#include <iterator>
+#include <memory>
+#include <algorithm>
+#include <cstddef>
+
+#include "diagnostics.hpp"
+
+
+/*
+ *  Makes the leaves of a subtree share the shift of their statement.
+ */
+class shift_assigner: public basic_visitor {
+public:
+  shift_assigner(const lexem_shift* shift): shift(shift) {}
+
+  virtual void visit(node& n) {
+    accept_chain_children(n, this, true);
+  }
+
+  virtual void visit(leaf& l) {
+    l.set_shift(shift);
+  }
+
+private:
+  const lexem_shift* shift;
+};
+
+
+/*
+ *  Keeps the tokens, white spaces and tree of a text, and brings them
+ *  up to date after an edit without lexing and parsing it all again.
+ *
+ *  The lexer is restarted at the first token of the top level
+ *  statement enclosing the edit, provided the token is preceded by
+ *  white spaces, so that no token before it can be extended by the
+ *  edit. Since the lexer has no state besides its position, the
+ *  tokens are identical to the old ones as soon as a new token starts
+ *  where an old one started, past the edit. Relexing stops there if
+ *  that old token starts a top level statement, and if its column is
+ *  unchanged.
+ *
+ *  The tokens and leaves after that point keep the ids, coordinates
+ *  and offsets they were lexed with. Each top level statement has a
+ *  shift, shared by its leaves, which the edit adds to for all the
+ *  statements after it: an update costs the size of the statements
+ *  relexed plus one addition per statement, and the lexer is never
+ *  run on the statements that did not change.
+ *
+ *  The statements relexed are parsed on their own, followed by the
+ *  final endmacro, and spliced in the stmt_list of the macro_file in
+ *  place of the old ones. The grammar being LR(1), the result is the
+ *  tree a parse of the whole text would give. When the fragment does
+ *  not parse, when the text has syntax errors, or when the edit is
+ *  outside of the statements, the whole text is parsed again, with
+ *  the error recovery, which reports all the syntax errors.
+ */
+class incremental_parser {
+public:
+  using token_type = token<symbol>;
+  using coord_t = file_source_coordinate_range;
+
+  incremental_parser(const lr_parser<symbol>& p, const recovery_table& recovery)
+    : p(p), recovery(recovery), lexer(build_alint_lexer()),
+      tree(nullptr), macro_file(nullptr), pair_rule(-1),
+      lex_errors(false), incremental(false) {
+    lexer.set_source(&source);
+  }
+
+  incremental_parser(const incremental_parser&) = delete;
+  incremental_parser& operator=(const incremental_parser&) = delete;
+
+  ~incremental_parser() {
+    clear();
+  }
+
+  /*
+   *  The limits of the CLI, checked on the whole text when it is
+   *  parsed, and on the statements relexed by an update, which start
+   *  at the top level. A text exceeding them throws limit_exceeded and
+   *  has no tree.
+   */
+  void set_limits(const resource_limits& limits) { budget.set_limits(limits); }
+
+  /*
+   *  Lex and parse the whole text. The tree keeps the parts with syntax
+   *  errors in recovered nodes.
+   */
+  void set_text(const std::string& name, const std::string& content) {
+    filename = name;
+    text = content;
+    incremental = false;
+    parse();
+  }
+
+  /*
+   *  Replace the characters [begin, end) of the text by replacement.
+   */
+  void update(std::size_t begin, std::size_t end, const std::string& replacement) {
+    if (begin > end or end > text.size())
+      throw std::string("error: edit out of the range of ") + filename;
+
+    text.replace(begin, end - begin, replacement);
+    incremental = (tree and not lex_errors and parse_errors.empty()
+                   and update_statements(begin, end, replacement.size()));
+    if (not incremental)
+      parse();
+  }
+
+  basic_node* get_tree() const { return tree; }
+
+  const std::vector<std::string>& get_white_spaces() const { return white_spaces; }
+  const std::string& get_text() const { return text; }
+  const std::string& get_filename() const { return filename; }
+
+  /*
+   *  Whether the last update was made without a full parse.
+   */
+  bool was_incremental() const { return incremental; }
+
+  bool has_lex_errors() const { return lex_errors; }
+
+  /*
+   *  The syntax errors of the text, as of its last update.
+   */
+  const std::vector<diagnostic>& get_parse_errors() const { return parse_errors; }
+
+  /*
+   *  The stmt_list of the top level statement containing offset, and
+   *  the last token before it, or nullptr. Returns nullptr when there
+   *  is no statement.
+   */
+  node* statements_from(std::size_t offset, const leaf*& before) const {
+    before = nullptr;
+    if (spine.empty())
+      return nullptr;
+
+    const std::size_t s(statement_containing(first_token_reaching(offset)));
+    if (s > 0)
+      before = spine[s - 1]->get_children()[0]->get_last_leaf();
+    return spine[s];
+  }
+
+private:
+  const lr_parser<symbol>& p;
+  const recovery_table& recovery;
+  file_source<token_type> source;
+  regex_lexer<token_type> lexer;
+  file_budget budget;
+
+  std::string filename;
+  std::string text;
+  std::vector<token_type*> lexems;
+  std::vector<std::string> white_spaces;
+  std::vector<std::size_t> offsets;
+
+  basic_node* tree;
+  node* macro_file;
+  std::vector<node*> spine;
+  int pair_rule;
+
+  /*
+   *  The shift of the lexems of each top level statement, then the one
+   *  of the final endmacro and of the end of input.
+   */
+  struct statement_shift: lexem_shift {
+    statement_shift(): offset(0) {}
+
+    std::ptrdiff_t offset;
+  };
+
+  std::vector<std::unique_ptr<statement_shift> > shifts;
+
+  bool lex_errors;
+  std::vector<diagnostic> parse_errors;
+  bool incremental;
+
+  void clear() {
+    delete tree;
+    tree = nullptr;
+    macro_file = nullptr;
+    spine.clear();
+    shifts.clear();
+
+    for (auto lexem: lexems)
+      delete lexem;
+    lexems.clear();
+    white_spaces.clear();
+    offsets.clear();
+  }
+
+  void parse() {
+    clear();
+    lex_errors = false;
+    parse_errors.clear();
+
+    budget.start(filename);
+    budget.check_size(filename, text.size());
+
+    padded_streambuf buffer("", text.data(), text.data() + text.size());
+    std::istream stream(&buffer);
+    source.set_file(&stream, filename);
+
+    std::size_t offset(0);
+    lex_error_reporter errors;
+    while (lexems.empty() or lexems.back()->symbol != symbol::eoi) {
+      try {
+        token_type* t(lexer.get());
+        errors.flush();
+        lexems.push_back(t);
+        white_spaces.push_back(lexer.get_skipped_characters());
+        offset += white_spaces.back().size();
+        offsets.push_back(offset);
+        offset += t->value.size();
+        budget.count(*t);
+      }
+      catch (const lex_error& e) {
+        errors.add(e);
+        lex_errors = true;
+        lexer.recover();
+      }
+    }
+
+    token_replay_source input(lexems.data(), lexems.data() + lexems.size(), 1);
+    tree_factory<symbol> factory;
+    auto handler([&](const parse_error<token_type>& e) {
+        const coord_t* c(dynamic_cast<const coord_t*>(e.get_unexpected_token().get_coordinates()));
+        parse_errors.push_back(diagnostic(filename, c->get_line(), c->get_column(),
+                                          "error", parse_error_message(e), "parse-error"));
+      });
+    tree = parse_input_with_recovery(p, recovery, input, factory, handler);
+    if (not tree)
+      throw std::string(filename + ": parse failed");
+
+    macro_file = find_macro_file(tree);
+    if (macro_file and macro_file->get_children().size() == 2)
+      append_statement_spine(static_cast<node*>(macro_file->get_children()[0]), spine, pair_rule);
+    if (spine.empty())
+      return;
+
+    for (std::size_t s(0); s < spine.size(); ++s)
+      shifts.push_back(new_shift(spine[s]->get_children()[0]));
+    shifts.push_back(new_shift(macro_file->get_children()[1]));
+  }
+
+  static std::unique_ptr<statement_shift> new_shift(basic_node* statement) {
+    std::unique_ptr<statement_shift> shift(new statement_shift);
+    shift_assigner assigner(shift.get());
+    statement->accept(&assigner);
+    return shift;
+  }
+
+  std::size_t statement_first_index(std::size_t s) const {
+    if (s == spine.size())
+      return lexems.size() - 2;
+    return spine[s]->get_first_lexem_id() - 1;
+  }
+
+  std::size_t statement_of_token(std::size_t t) const {
+    return t + 2 >= lexems.size() ? spine.size() : statement_containing(t);
+  }
+
+  std::size_t offset_of(std::size_t t) const {
+    return offsets[t] + shifts[statement_of_token(t)]->offset;
+  }
+
+  std::size_t line_of(std::size_t t) const {
+    return dynamic_cast<const coord_t*>(lexems[t]->get_coordinates())->get_line()
+      + shifts[statement_of_token(t)]->lines;
+  }
+
+  /*
+   *  Index of the last top level statement starting at or before the
+   *  token of index t.
+   */
+  std::size_t statement_containing(std::size_t t) const {
+    std::size_t low(0), high(spine.size());
+    while (high - low > 1) {
+      const std::size_t middle((low + high) / 2);
+      if (statement_first_index(middle) <= t)
+        low = middle;
+      else
+        high = middle;
+    }
+    return low;
+  }
+
+  /*
+   *  Index of the first token ending at or after offset, which an
+   *  edit starting at offset may extend.
+   */
+  std::size_t first_token_reaching(std::size_t offset) const {
+    std::size_t low(0), high(lexems.size());
+    while (low < high) {
+      const std::size_t middle((low + high) / 2);
+      if (offset_of(middle) + lexems[middle]->value.size() < offset)
+        low = middle + 1;
+      else
+        high = middle;
+    }
+    return low;
+  }
+
+  std::size_t token_at_offset(std::size_t offset) const {
+    std::size_t low(0), high(lexems.size());
+    while (low < high) {
+      const std::size_t middle((low + high) / 2);
+      if (offset_of(middle) < offset)
+        low = middle + 1;
+      else
+        high = middle;
+    }
+    return low < lexems.size() and offset_of(low) == offset ? low : lexems.size();
+  }
+
+  static std::size_t column_of(const token_type* t) {
+    return dynamic_cast<const coord_t*>(t->get_coordinates())->get_column();
+  }
+
+  /*
+   *  The text has already been edited: [begin, end) of the old text
+   *  is now [begin, begin + inserted). Returns false, with the tokens
+   *  and tree unchanged, when the whole text has to be parsed again.
+   */
+  bool update_statements(std::size_t begin, std::size_t end, std::size_t inserted) {
+    const std::size_t n(lexems.size());
+    const resource_limits& limits(budget.get_limits());
+    if (spine.empty() or pair_rule < 0 or n < 2
+        or (limits.max_file_size and text.size() > limits.max_file_size))
+      return false;
+
+    const std::size_t endmacro(n - 2);
+    const std::size_t edit_end(begin + inserted);
+    const std::ptrdiff_t delta(static_cast<std::ptrdiff_t>(inserted) -
+                               static_cast<std::ptrdiff_t>(end - begin));
+
+    const std::size_t a(first_token_reaching(begin));
+    if (a >= endmacro)
+      return false;
+
+    std::size_t i(statement_containing(a));
+    while (i > 0 and (white_spaces[statement_first_index(i)].empty()
+                      or offset_of(statement_first_index(i)) > begin))
+      --i;
+
+    const std::size_t r(statement_first_index(i));
+    std::string padding;
+    std::size_t position(0);
+    if (i > 0) {
+      padding = std::string(line_of(r) - 1, '\n') + std::string(column_of(lexems[r]), ' ');
+      position = offset_of(r);
+    }
+
+    padded_streambuf buffer(padding, text.data() + position, text.data() + text.size());
+    std::istream stream(&buffer);
+    source.set_file(&stream, filename);
+
+    std::vector<token_type*> fresh;
+    std::vector<std::string> fresh_white_spaces;
+    std::vector<std::size_t> fresh_offsets;
+    std::string resync_white_spaces;
+    std::size_t q(n);
+    std::ptrdiff_t line_delta(0);
+
+    auto abandon([&]() {
+        for (auto t: fresh)
+          delete t;
+        return false;
+      });
+
+    budget.start(filename);
+    try {
+      std::size_t cursor(position);
+      while (q == n) {
+        token_type* t(lexer.get());
+        std::string skipped(lexer.get_skipped_characters());
+        if (fresh.empty() and i > 0)
+          skipped.erase(0, padding.size());
+
+        const std::size_t offset(cursor + skipped.size());
+        cursor = offset + t->value.size();
+        if (fresh.empty() and i > 0)
+          skipped = white_spaces[r] + skipped;
+
+        if (t->symbol == symbol::eoi) {
+          delete t;
+          return abandon();
+        }
+
+        if (offset >= edit_end and not fresh.empty()) {
+          const std::size_t candidate(token_at_offset(offset - delta));
+          if (candidate < n and (candidate == endmacro or
+                                 statement_first_index(statement_containing(candidate)) == candidate)
+              and column_of(t) == column_of(lexems[candidate])) {
+            const coord_t* c(dynamic_cast<const coord_t*>(t->get_coordinates()));
+            line_delta = static_cast<std::ptrdiff_t>(c->get_line())
+              - static_cast<std::ptrdiff_t>(line_of(candidate));
+            q = candidate;
+            resync_white_spaces = skipped;
+            delete t;
+            break;
+          }
+        }
+
+        fresh.push_back(t);
+        fresh_white_spaces.push_back(skipped);
+        fresh_offsets.push_back(offset);
+        budget.count(*t);
+      }
+    }
+    catch (const lex_error&) {
+      return abandon();
+    }
+    catch (const limit_exceeded&) {
+      return abandon();
+    }
+
+    if (limits.max_tokens and n - (q - r) + fresh.size() > limits.max_tokens)
+      return abandon();
+
+    /*
+     *  Parse the statements relexed on their own.
+     */
+    token_replay_source input(fresh.data(), fresh.data() + fresh.size(), r + 1,
+                              lexems[endmacro], lexems[n - 1]);
+    tree_factory<symbol> factory;
+    silent_error_handler<token_type> handler;
+    basic_node* fragment(parse_input_with_recovery(p, recovery, input, factory, handler));
+
+    node* fragment_file(find_macro_file(fragment));
+    if (not handler.status or not fragment_file or fragment_file->get_children().size() != 2) {
+      delete fragment;
+      return abandon();
+    }
+
+    node* head(static_cast<node*>(fragment_file->replace_child(0, nullptr)));
+    delete fragment;
+
+    std::vector<node*> fresh_spine;
+    append_statement_spine(head, fresh_spine, pair_rule);
+
+    /*
+     *  Splice the new statements in place of the old ones, [i, j).
+     */
+    const std::size_t j(q == endmacro ? spine.size() : statement_containing(q));
+    if (j < spine.size()) {
+      node* last(fresh_spine.back());
+      std::vector<basic_node*> children{last->replace_child(0, nullptr), spine[j]};
+      node* joined(new node(symbol::stmt_list, pair_rule, children.begin(), children.end()));
+      delete last;
+      if (fresh_spine.size() > 1)
+        fresh_spine[fresh_spine.size() - 2]->replace_child(1, joined);
+      else
+        head = joined;
+      fresh_spine.back() = joined;
+    }
+
+    node* old_head(j > i ? spine[i] : nullptr);
+    if (j > i and j < spine.size())
+      spine[j - 1]->replace_child(1, nullptr);
+
+    if (i > 0)
+      spine[i - 1]->replace_child(1, head);
+    else
+      macro_file->replace_child(0, head);
+    delete old_head;
+
+    spine.erase(spine.begin() + i, spine.begin() + j);
+    spine.insert(spine.begin() + i, fresh_spine.begin(), fresh_spine.end());
+
+    /*
+     *  Splice the tokens, the old ones after the edit keep their ids,
+     *  lines and offsets.
+     */
+    for (std::size_t k(r); k < q; ++k)
+      delete lexems[k];
+    splice(lexems, r, q, fresh);
+    splice(white_spaces, r, q, fresh_white_spaces);
+    splice(offsets, r, q, fresh_offsets);
+    white_spaces[r + fresh.size()] = resync_white_spaces;
+
+    /*
+     *  The new statements are lexed where they are, the ones after them
+     *  are shifted by the edit.
+     */
+    std::vector<std::unique_ptr<statement_shift> > fresh_shifts;
+    for (auto s: fresh_spine)
+      fresh_shifts.push_back(new_shift(s->get_children()[0]));
+    splice(shifts, i, j, fresh_shifts);
+
+    const std::ptrdiff_t id_delta(static_cast<std::ptrdiff_t>(fresh.size()) -
+                                  static_cast<std::ptrdiff_t>(q - r));
+    for (std::size_t s(i + fresh_spine.size()); s < shifts.size(); ++s) {
+      shifts[s]->ids += id_delta;
+      shifts[s]->lines += line_delta;
+      shifts[s]->offset += delta;
+    }
+
+    return true;
+  }
+
+  /*
+   *  Replaces the elements [first, last) of v by replacement, moving
+   *  the elements after them only when the sizes differ.
+   */
+  template<typename element_type>
+  static void splice(std::vector<element_type>& v, std::size_t first, std::size_t last,
+                     std::vector<element_type>& replacement) {
+    const std::size_t common(std::min(last - first, replacement.size()));
+    std::move(replacement.begin(), replacement.begin() + common, v.begin() + first);
+    if (common < replacement.size())
+      v.insert(v.begin() + first + common,
+               std::make_move_iterator(replacement.begin() + common),
+               std::make_move_iterator(replacement.end()));
+    else
+      v.erase(v.begin() + first + common, v.begin() + last);
+  }
+};
+
+#endif /* INCREMENTAL_H */
@@ -0,0 +1,300 @@
+#ifndef JSON_H
+#define JSON_H
+
+#include <string>
+#include <vector>
+#include <utility>
+#include <sstream>
+#include <cstdio>
+#include <cstdlib>
+
+
+inline
+std::string json_escape(const std::string& s) {
+  std::string result;
+  result.reserve(s.size() + 2);
+  for (const char c: s) {
+    switch (c) {
+    case '"': result += "\\\""; break;
+    case '\\': result += "\\\\"; break;
+    case '\n': result += "\\n"; break;
+    case '\r': result += "\\r"; break;
+    case '\t': result += "\\t"; break;
+    default:
+      if (static_cast<unsigned char>(c) < 0x20) {
+        char buffer[8];
+        std::snprintf(buffer, sizeof(buffer), "\\u%04x", c);
+        result += buffer;
+      } else {
+        result += c;
+      }
+      break;
+    }
+  }
+  return result;
+}
+
+
+/*
+ *  Minimal JSON document model, enough for the language server
+ *  protocol messages.
+ */
+class json_value {
+public:
+  enum class type { null, boolean, number, string, array, object };
+
+  json_value(): t(type::null), b(false), n(0.0) {}
+  json_value(bool v): t(type::boolean), b(v), n(0.0) {}
+  json_value(int v): t(type::number), b(false), n(v) {}
+  json_value(std::size_t v): t(type::number), b(false), n(v) {}
+  json_value(double v): t(type::number), b(false), n(v) {}
+  json_value(const char* v): t(type::string), b(false), n(0.0), s(v) {}
+  json_value(const std::string& v): t(type::string), b(false), n(0.0), s(v) {}
+
+  static json_value array() { json_value v; v.t = type::array; return v; }
+  static json_value object() { json_value v; v.t = type::object; return v; }
+
+  static json_value parse(const std::string& text) {
+    std::size_t position(0);
+    json_value v(parse_value(text, position));
+    skip_spaces(text, position);
+    if (position != text.size())
+      throw std::string("error: trailing characters in json document.");
+    return v;
+  }
+
+  type get_type() const { return t; }
+  bool is_null() const { return t == type::null; }
+
+  bool get_bool() const { return b; }
+  double get_number() const { return n; }
+  const std::string& get_string() const { return s; }
+  const std::vector<json_value>& get_array() const { return elements; }
+
+  json_value& set(const std::string& key, const json_value& value) {
+    for (auto& m: members)
+      if (m.first == key) {
+        m.second = value;
+        return *this;
+      }
+    members.push_back(std::make_pair(key, value));
+    return *this;
+  }
+
+  json_value& push_back(const json_value& value) {
+    elements.push_back(value);
+    return *this;
+  }
+
+  const json_value& operator[](const std::string& key) const {
+    static const json_value null_value;
+    for (const auto& m: members)
+      if (m.first == key)
+        return m.second;
+    return null_value;
+  }
+
+  std::string dump() const {
+    std::ostringstream oss;
+    dump(oss);
+    return oss.str();
+  }
+
+  void dump(std::ostream& stream) const {
+    switch (t) {
+    case type::null: stream << "null"; break;
+    case type::boolean: stream << (b ? "true" : "false"); break;
+    case type::number:
+      if (n == static_cast<double>(static_cast<long long>(n)))
+        stream << static_cast<long long>(n);
+      else
+        stream << n;
+      break;
+    case type::string: stream << '"' << json_escape(s) << '"'; break;
+    case type::array:
+      stream << '[';
+      for (std::size_t i(0); i < elements.size(); ++i) {
+        if (i)
+          stream << ',';
+        elements[i].dump(stream);
+      }
+      stream << ']';
+      break;
+    case type::object:
+      stream << '{';
+      for (std::size_t i(0); i < members.size(); ++i) {
+        if (i)
+          stream << ',';
+        stream << '"' << json_escape(members[i].first) << "\":";
+        members[i].second.dump(stream);
+      }
+      stream << '}';
+      break;
+    }
+  }
+
+private:
+  type t;
+  bool b;
+  double n;
+  std::string s;
+  std::vector<json_value> elements;
+  std::vector<std::pair<std::string, json_value> > members;
+
+  static void skip_spaces(const std::string& text, std::size_t& position) {
+    while (position < text.size()
+           and (text[position] == ' ' or text[position] == '\t'
+                or text[position] == '\n' or text[position] == '\r'))
+      ++position;
+  }
+
+  static void expect(const std::string& text, std::size_t& position, const std::string& word) {
+    if (text.compare(position, word.size(), word) != 0)
+      throw std::string("error: malformed json document.");
+    position += word.size();
+  }
+
+  static void append_utf8(std::string& result, unsigned long code_point) {
+    if (code_point < 0x80) {
+      result += static_cast<char>(code_point);
+    } else if (code_point < 0x800) {
+      result += static_cast<char>(0xc0 | (code_point >> 6));
+      result += static_cast<char>(0x80 | (code_point & 0x3f));
+    } else if (code_point < 0x10000) {
+      result += static_cast<char>(0xe0 | (code_point >> 12));
+      result += static_cast<char>(0x80 | ((code_point >> 6) & 0x3f));
+      result += static_cast<char>(0x80 | (code_point & 0x3f));
+    } else {
+      result += static_cast<char>(0xf0 | (code_point >> 18));
+      result += static_cast<char>(0x80 | ((code_point >> 12) & 0x3f));
+      result += static_cast<char>(0x80 | ((code_point >> 6) & 0x3f));
+      result += static_cast<char>(0x80 | (code_point & 0x3f));
+    }
+  }
+
+  static unsigned long parse_hex4(const std::string& text, std::size_t& position) {
+    if (position + 4 > text.size())
+      throw std::string("error: malformed json string.");
+    const unsigned long v(std::strtoul(text.substr(position, 4).c_str(), nullptr, 16));
+    position += 4;
+    return v;
+  }
+
+  static std::string parse_string(const std::string& text, std::size_t& position) {
+    expect(text, position, "\"");
+    std::string result;
+    while (position < text.size() and text[position] != '"') {
+      if (text[position] != '\\') {
+        result += text[position++];
+        continue;
+      }
+
+      if (++position >= text.size())
+        break;
+      switch (text[position++]) {
+      case '"': result += '"'; break;
+      case '\\': result += '\\'; break;
+      case '/': result += '/'; break;
+      case 'b': result += '\b'; break;
+      case 'f': result += '\f'; break;
+      case 'n': result += '\n'; break;
+      case 'r': result += '\r'; break;
+      case 't': result += '\t'; break;
+      case 'u': {
+        unsigned long code_point(parse_hex4(text, position));
+        if (code_point >= 0xd800 and code_point < 0xdc00
+            and text.compare(position, 2, "\\u") == 0) {
+          position += 2;
+          const unsigned long low(parse_hex4(text, position));
+          code_point = 0x10000 + ((code_point - 0xd800) << 10) + (low - 0xdc00);
+        }
+        append_utf8(result, code_point);
+      }
+        break;
+      default:
+        throw std::string("error: malformed json string.");
+      }
+    }
+    expect(text, position, "\"");
+    return result;
+  }
+
+  static json_value parse_value(const std::string& text, std::size_t& position) {
+    skip_spaces(text, position);
+    if (position >= text.size())
+      throw std::string("error: unexpected end of json document.");
+
+    switch (text[position]) {
+    case '{': {
+      json_value v(object());
+      ++position;
+      skip_spaces(text, position);
+      if (position < text.size() and text[position] == '}') {
+        ++position;
+        return v;
+      }
+      while (true) {
+        skip_spaces(text, position);
+        const std::string key(parse_string(text, position));
+        skip_spaces(text, position);
+        expect(text, position, ":");
+        v.members.push_back(std::make_pair(key, parse_value(text, position)));
+        skip_spaces(text, position);
+        if (position < text.size() and text[position] == ',') {
+          ++position;
+          continue;
+        }
+        expect(text, position, "}");
+        return v;
+      }
+    }
+
+    case '[': {
+      json_value v(array());
+      ++position;
+      skip_spaces(text, position);
+      if (position < text.size() and text[position] == ']') {
+        ++position;
+        return v;
+      }
+      while (true) {
+        v.elements.push_back(parse_value(text, position));
+        skip_spaces(text, position);
+        if (position < text.size() and text[position] == ',') {
+          ++position;
+          continue;
+        }
+        expect(text, position, "]");
+        return v;
+      }
+    }
+
+    case '"':
+      return json_value(parse_string(text, position));
+
+    case 't':
+      expect(text, position, "true");
+      return json_value(true);
+
+    case 'f':
+      expect(text, position, "false");
+      return json_value(false);
+
+    case 'n':
+      expect(text, position, "null");
+      return json_value();
+
+    default: {
+      const char* begin(text.c_str() + position);
+      char* end(nullptr);
+      const double v(std::strtod(begin, &end));
+      if (end == begin)
+        throw std::string("error: malformed json document.");
+      position += end - begin;
+      return json_value(v);
+    }
+    }
+  }
+};
+
+#endif /* JSON_H */
@@ -1,12 +1,19 @@
 #ifndef ALINT_LEXER_H
 #define ALINT_LEXER_H
 
+#include <sstream>
+#include <streambuf>
+
 #include "file_utils.hpp"
+#include "diagnostics.hpp"
+#include "trace.hpp"
+#include "limits.hpp"
 
 
 typedef token<symbol> token_type;
 
 regex_lexer<token<symbol> > build_alint_lexer() {
+  trace_span span("build_alint_lexer");
   typedef symbol symbol_type;
   typedef token<symbol_type> token_type;
 
@@ -53,6 +60,91 @@ regex_lexer<token<symbol> > build_alint_lexer() {
   return rlb.build();
 }
 
+/*
+ *  Reports the lex errors of a file. Consecutive errors, with no token
+ *  lexed in between, are reported as one diagnostic spanning the
+ *  invalid characters, once the next token is lexed. At most
+ *  max_reports diagnostics are reported per file, then a last one
+ *  notes that the next errors are not.
+ */
+class lex_error_reporter {
+public:
+  static const std::size_t default_max_reports = 32;
+
+  lex_error_reporter()
+    : max_reports(default_max_reports), characters(0), reports(0), invalid_characters(0) {}
+
+  /*
+   *  0 for the default.
+   */
+  void set_max_reports(std::size_t max) {
+    max_reports = default_max_reports;
+    if (max)
+      max_reports = max;
+  }
+
+  void start() {
+    flush();
+    reports = 0;
+    invalid_characters = 0;
+  }
+
+  void add(const lex_error& e) {
+    const file_source_coordinate_range* c(
+      dynamic_cast<const file_source_coordinate_range*>(e.get_coordinates()));
+    if (not characters) {
+      filename = c->get_filename();
+      line = c->get_line();
+      column = c->get_column();
+      location = c->render();
+      message = e.get_message();
+    }
+    last_line = c->get_line();
+    last_column = c->get_column();
+    ++characters;
+    ++invalid_characters;
+  }
+
+  /*
+   *  The number of invalid characters of the file, reported or not.
+   */
+  std::size_t get_invalid_characters() const { return invalid_characters; }
+
+  void flush() {
+    if (not characters)
+      return;
+
+    if (reports < max_reports) {
+      std::ostringstream m;
+      m << message;
+      if (characters > 1)
+        m << " (" << characters << " invalid characters, up to "
+          << last_line << ":" << last_column << ")";
+      report_diagnostic(diagnostic(filename, line, column, "error", m.str(), "lex-error", location));
+    } else if (reports == max_reports) {
+      report_diagnostic(diagnostic(filename, line, column, "error",
+                                   "too many lex errors, the next ones are not reported.",
+                                   "lex-error", location));
+    }
+    ++reports;
+    characters = 0;
+  }
+
+private:
+  std::size_t max_reports;
+  std::size_t characters;
+  std::size_t reports;
+  std::size_t invalid_characters;
+  std::string filename;
+  std::size_t line;
+  std::size_t column;
+  std::size_t last_line;
+  std::size_t last_column;
+  std::string location;
+  std::string message;
+};
+
+
 class alint_token_source {
 public:
   using symbol_type = symbol;
@@ -77,7 +169,21 @@ public:
       delete lexem;
   }
 
+  /*
+   *  The limits of the files given from now on. A file exceeding them
+   *  throws limit_exceeded, when it's set or while it's lexed.
+   */
+  void set_limits(const resource_limits& limits) {
+    budget.set_limits(limits);
+    errors.set_max_reports(limits.max_diagnostics);
+  }
+
+  const file_budget& get_budget() const { return budget; }
+
   void set_file(const std::string& filename) {
+    errors.start();
+    budget.start(filename);
+    budget.check_file_size();
     file.close();
     for (auto lexem: lexems)
       delete lexem;
@@ -89,39 +195,182 @@ public:
     next();
   }
 
+  /*
+   *  Lex an in-memory document instead of a file. The filename only
+   *  ends up in the coordinates of the tokens.
+   */
+  void set_buffer(const std::string& filename, const std::string& content) {
+    errors.start();
+    budget.start(filename);
+    budget.check_size(filename, content.size());
+    file.close();
+    for (auto lexem: lexems)
+      delete lexem;
+    white_spaces.clear();
+    lexems.clear();
+
+    buffer.clear();
+    buffer.str(content);
+    source.set_file(&buffer, filename);
+    next();
+  }
+
+  /*
+   *  Take the tokens and white spaces of a whole file lexed
+   *  beforehand, up to its eoi token.
+   */
+  void set_lexems(const std::string& filename,
+                  std::vector<token<symbol>* >&& l, std::vector<std::string>&& ws) {
+    errors.start();
+    budget.start(filename);
+    file.close();
+    for (auto lexem: lexems)
+      delete lexem;
+    lexems = std::move(l);
+    white_spaces = std::move(ws);
+
+    std::uint64_t size(0);
+    for (std::size_t i(0); i < lexems.size(); ++i)
+      size += white_spaces[i].size() + lexems[i]->value.size();
+    budget.check_size(filename, size);
+    for (auto lexem: lexems)
+      budget.count(*lexem);
+  }
+
+  /*
+   *  Whether the lexer skipped invalid characters in the file so far.
+   */
+  bool has_lex_errors() const { return errors.get_invalid_characters() > 0; }
+
   const token<symbol>& get() const { return *lexems.back(); }
   const std::string& get_skipped_spaces() const { return white_spaces.back(); }
   std::size_t get_lexem_id() const { return white_spaces.size(); }
   
+  /*
+   *  On a lex error, the lexer recovers and tries again, in a loop:
+   *  recursing would take one stack frame per bad character. A run of
+   *  invalid characters is reported once the next token is lexed.
+   */
   void next() {
-    try {
-      lexems.push_back(lexer.get());
-      white_spaces.push_back(lexer.get_skipped_characters());
-    }
-    catch (const lex_error& e) {
-      std::cout << e.get_coordinates()->render() << " error: " << e.get_message() << std::endl;
-      const file_source_coordinate_range* c(
-        dynamic_cast<const file_source_coordinate_range*>(
-          e.get_coordinates()));
-      show_coordinates_in_file(c->get_filename(), c->get_line(), c->get_column());
-      
-      lexer.recover();
-      next();
+    for (;;) {
+      try {
+        lexems.push_back(lexer.get());
+        white_spaces.push_back(lexer.get_skipped_characters());
+        errors.flush();
+        budget.count(*lexems.back());
+        return;
+      }
+      catch (const lex_error& e) {
+        errors.add(e);
+        lexer.recover();
+      }
     }
   }
 
   const std::vector<std::string>& get_white_spaces() const {
     return white_spaces;
   }
+
+  /*
+   *  Lex the rest of the input at once, so that the tokens can be
+   *  replayed to the parser.
+   */
+  void lex_to_end() {
+    while (get().symbol != symbol::eoi)
+      next();
+  }
+
+  const std::vector<token<symbol>* >& get_lexems() const {
+    return lexems;
+  }
   
 private:
   std::ifstream file;
+  std::istringstream buffer;
   file_source<token<symbol> > source;
   regex_lexer<token<symbol> > lexer;
 
   std::vector<token<symbol>* > lexems;
   std::vector<std::string> white_spaces;
+  file_budget budget;
+  lex_error_reporter errors;
 };
 
 
+/*
+ *  Input buffer serving a padding string, then the characters of
+ *  [begin, end) without copying them.
+ */
+class padded_streambuf: public std::streambuf {
+public:
+  padded_streambuf(const std::string& padding, const char* begin, const char* end)
+    : padding(padding), begin(begin), end(end), in_padding(true) {
+    char* p(&this->padding[0]);
+    setg(p, p, p + this->padding.size());
+  }
+
+protected:
+  virtual int_type underflow() override {
+    if (gptr() < egptr())
+      return traits_type::to_int_type(*gptr());
+
+    if (in_padding) {
+      in_padding = false;
+      char* b(const_cast<char*>(begin));
+      char* e(const_cast<char*>(end));
+      setg(b, b, e);
+      if (b < e)
+        return traits_type::to_int_type(*gptr());
+    }
+    return traits_type::eof();
+  }
+
+private:
+  std::string padding;
+  const char* begin;
+  const char* end;
+  bool in_padding;
+};
+
+
+/*
+ *  Token source replaying tokens lexed beforehand: the range [first,
+ *  last), then the optional tail tokens. The lexem ids are numbered
+ *  from first_id.
+ */
+class token_replay_source {
+public:
+  using symbol_type = symbol;
+  using token_type = token<symbol_type>;
+
+  token_replay_source(token_type* const* first, token_type* const* last,
+                      std::size_t first_id,
+                      const token_type* endmacro = nullptr,
+                      const token_type* eoi = nullptr)
+    : first(first), size(last - first), first_id(first_id), position(0) {
+    if (endmacro)
+      tail.push_back(endmacro);
+    if (eoi)
+      tail.push_back(eoi);
+  }
+
+  const token_type& get() const {
+    if (position < size)
+      return *first[position];
+    const std::size_t i(position - size);
+    return *tail[i < tail.size() ? i : tail.size() - 1];
+  }
+
+  std::size_t get_lexem_id() const { return first_id + position; }
+
+  void next() { ++position; }
+
+private:
+  token_type* const* first;
+  std::size_t size;
+  std::vector<const token_type*> tail;
+  std::size_t first_id;
+  std::size_t position;
+};
+
 #endif /* ALINT_LEXER_H */
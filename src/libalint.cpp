@@ -0,0 +1,238 @@
+#include <fstream>
+#include <sstream>
+#include <set>
+#include <queue>
+
+#include <cstdlib>
+
+#include <unistd.h>
+
+
+#include <spikes/timer.hpp>
+#include <spikes/ansi_iomanip.hpp>
+
+#include <parser/parser.hpp>
+#include <lexer/lexer.hpp>
+#include "token_source.hpp"
+
+#include "symbol.hpp"
+#include "lexer.hpp"
+#include "syntax_tree.hpp"
+#include "parser.hpp"
+#include "recovery.hpp"
+
+#include "syntax_checkers.hpp"
+
+#include "libalint.hpp"
+
+
+namespace alint {
+
+namespace {
+
+diagnostic convert(const ::diagnostic& d) {
+  return diagnostic{d.filename, d.line, d.column,
+                    d.severity == "warning" ? severity::warning : severity::error,
+                    d.message};
+}
+
+/*
+ *  Collects the warnings and lexing errors of its scope.
+ */
+class collector_scope {
+public:
+  collector_scope(): previous(diagnostic_collector()) {
+    diagnostic_collector() = &collected;
+  }
+
+  ~collector_scope() {
+    diagnostic_collector() = previous;
+  }
+
+  void append_to(std::vector<diagnostic>& diagnostics) const {
+    for (const auto& d: collected)
+      diagnostics.push_back(convert(d));
+  }
+
+private:
+  std::vector<::diagnostic>* previous;
+  std::vector<::diagnostic> collected;
+};
+
+}
+
+
+struct document::implementation {
+  implementation(): tree(nullptr), recovered(false) {}
+  ~implementation() {
+    delete tree;
+  }
+
+  std::string filename;
+  basic_node* tree;
+  bool recovered;
+  std::vector<std::string> white_spaces;
+  std::vector<diagnostic> diagnostics;
+};
+
+document::document(std::unique_ptr<implementation> i): impl(std::move(i)) {}
+document::document(document&&) = default;
+document& document::operator=(document&&) = default;
+document::~document() {}
+
+const std::string& document::get_filename() const { return impl->filename; }
+bool document::parsed() const { return impl->tree and not impl->recovered; }
+const basic_node* document::get_tree() const { return impl->tree; }
+
+void document::print_tree(std::ostream& stream) const {
+  if (impl->tree)
+    impl->tree->show(stream);
+}
+
+const std::vector<diagnostic>& document::get_diagnostics() const {
+  return impl->diagnostics;
+}
+
+
+struct context::implementation {
+  implementation(): g(build_cf_grammar()), p(g), recovery(p, g) {}
+
+  cf_grammar<symbol> g;
+  lr_parser<symbol> p;
+  recovery_table recovery;
+  alint_token_source tokens;
+  options opt;
+
+  /*
+   *  Parse what set_input gave to the token source.
+   */
+  template<typename function_type>
+  document parse(const std::string& filename, function_type set_input) {
+    using token_type = token<symbol>;
+    using coord_t = file_source_coordinate_range;
+
+    std::unique_ptr<document::implementation> result(new document::implementation);
+    result->filename = filename;
+
+    collector_scope scope;
+    try {
+      set_input();
+      tree_factory<symbol> factory;
+      auto handler([&](const parse_error<token_type>& e) {
+          result->recovered = true;
+          const coord_t* c(dynamic_cast<const coord_t*>(e.get_unexpected_token().get_coordinates()));
+          result->diagnostics.push_back(diagnostic{filename, c->get_line(), c->get_column(),
+                                                   severity::error, parse_error_message(e)});
+        });
+      result->tree = parse_input_with_recovery(p, recovery, tokens, factory, handler);
+      if (result->tree)
+        result->white_spaces = tokens.get_white_spaces();
+    }
+    catch (const std::string& e) {
+      result->diagnostics.push_back(diagnostic{filename, 1, 0, severity::error, e});
+    }
+    catch (const limit_exceeded& e) {
+      result->diagnostics.push_back(diagnostic{e.filename, e.line, e.column, severity::error, e.message});
+    }
+    scope.append_to(result->diagnostics);
+
+    return document(std::move(result));
+  }
+};
+
+
+context::context(): impl(new implementation) {}
+context::~context() {}
+
+void context::set_macro_directories(const std::string& global_macro_dir,
+                                    const std::string& local_macro_dir) {
+  impl->opt.global_macro_dir = global_macro_dir;
+  impl->opt.local_macro_dir = local_macro_dir;
+}
+
+document context::parse_file(const std::string& path) {
+  return impl->parse(path, [&]() {
+      if (not std::ifstream(path.c_str(), std::ios::in))
+        throw std::string("could not open ") + path;
+      impl->tokens.set_file(path);
+    });
+}
+
+document context::parse_buffer(const std::string& filename, const std::string& content) {
+  return impl->parse(filename, [&]() {
+      impl->tokens.set_buffer(filename, content);
+    });
+}
+
+std::vector<diagnostic> context::check(const document& d, unsigned int rules) {
+  std::vector<diagnostic> result;
+  if (not d.impl->tree)
+    return result;
+
+  collector_scope scope;
+  if (rules & do_enddo_guards)
+    check_do_enddo_guards(d.impl->tree);
+  if (rules & white_spaces)
+    check_white_spaces(d.impl->tree, d.impl->white_spaces);
+  scope.append_to(result);
+  return result;
+}
+
+std::vector<diagnostic> context::validate_file(const std::string& path, unsigned int rules) {
+  const document d(parse_file(path));
+  std::vector<diagnostic> result(d.get_diagnostics());
+  const std::vector<diagnostic> warnings(check(d, rules));
+  result.insert(result.end(), warnings.begin(), warnings.end());
+  return result;
+}
+
+std::vector<diagnostic> context::validate_buffer(const std::string& filename,
+                                                 const std::string& content,
+                                                 unsigned int rules) {
+  const document d(parse_buffer(filename, content));
+  std::vector<diagnostic> result(d.get_diagnostics());
+  const std::vector<diagnostic> warnings(check(d, rules));
+  result.insert(result.end(), warnings.begin(), warnings.end());
+  return result;
+}
+
+std::vector<dependency> context::get_dependencies(const document& d) {
+  std::vector<dependency> result;
+  if (not d.impl->tree)
+    return result;
+
+  for (const auto& item: extract_dependencies(d.impl->tree, impl->opt)) {
+    dependency_kind kind(dependency_kind::input);
+    switch (item.second) {
+    case ::dependency_kind::input: kind = dependency_kind::input; break;
+    case ::dependency_kind::local_macro: kind = dependency_kind::local_macro; break;
+    case ::dependency_kind::global_macro: kind = dependency_kind::global_macro; break;
+    }
+    result.push_back(dependency{item.first, kind});
+  }
+  return result;
+}
+
+std::vector<dependency> context::get_transitive_dependencies(const std::string& path) {
+  std::vector<dependency> result;
+  std::set<std::string> visited{path};
+  std::queue<std::string> unvisited;
+  unvisited.push(path);
+
+  while (not unvisited.empty()) {
+    const std::string file(unvisited.front());
+    unvisited.pop();
+    if (not std::ifstream(file.c_str(), std::ios::in))
+      continue;
+
+    for (const auto& d: get_dependencies(parse_file(file))) {
+      if (visited.insert(d.filename).second) {
+        result.push_back(d);
+        unvisited.push(d.filename);
+      }
+    }
+  }
+  return result;
+}
+
+}
@@ -0,0 +1,142 @@
+#ifndef LIBALINT_H
+#define LIBALINT_H
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <ostream>
+#include <cstddef>
+
+
+/*
+ *  In-process API of alint, for programs which validate macro files
+ *  without running the alint executable. Link with -lalint -llexer.
+ *
+ *  A context holds the grammar and the parser tables, which are built
+ *  once; parsing and checking a file afterwards costs no more than the
+ *  lexing, the parsing and the visit of its tree. A context is used by
+ *  one thread at a time, distinct contexts may be used concurrently.
+ *
+ *  The errors in the files, including a file which can't be read and
+ *  one exceeding the resource limits (such as more than 1024 nested
+ *  blocks), are returned as error diagnostics. The functions throw
+ *  nothing else than std::bad_alloc, when memory runs out.
+ */
+
+class basic_node;
+
+namespace alint {
+
+enum class severity {
+  error, warning
+};
+
+struct diagnostic {
+  std::string filename;
+  std::size_t line;
+  std::size_t column;
+  alint::severity severity;
+  std::string message;
+};
+
+enum rule: unsigned int {
+  no_rules = 0,
+  do_enddo_guards = 1 << 0,
+  white_spaces = 1 << 1,
+  all_rules = do_enddo_guards | white_spaces
+};
+
+enum class dependency_kind {
+  input, local_macro, global_macro
+};
+
+struct dependency {
+  std::string filename;
+  dependency_kind kind;
+};
+
+
+/*
+ *  The tree of a parsed file, and its errors. The parts of the file
+ *  with a syntax error are kept in recovered nodes of the tree, which
+ *  the checks skip.
+ */
+class document {
+public:
+  document(document&&);
+  document& operator=(document&&);
+  ~document();
+
+  const std::string& get_filename() const;
+
+  /*
+   *  Whether the file parsed without syntax errors, in which case
+   *  get_tree isn't null. The tree of a file with syntax errors is
+   *  null only when the parse could not recover up to its end.
+   */
+  bool parsed() const;
+  const basic_node* get_tree() const;
+  void print_tree(std::ostream& stream) const;
+
+  /*
+   *  The lexing and parsing errors.
+   */
+  const std::vector<diagnostic>& get_diagnostics() const;
+
+private:
+  friend class context;
+  struct implementation;
+
+  document(std::unique_ptr<implementation> i);
+  std::unique_ptr<implementation> impl;
+};
+
+
+class context {
+public:
+  /*
+   *  The macro directories are taken from ALUCELL_GLOBAL_MACRO_DIR and
+   *  ALUCELL_LOCAL_MACRO_DIR, unless set_macro_directories is called.
+   */
+  context();
+  context(const context&) = delete;
+  context& operator=(const context&) = delete;
+  ~context();
+
+  void set_macro_directories(const std::string& global_macro_dir,
+                             const std::string& local_macro_dir);
+
+  document parse_file(const std::string& path);
+  document parse_buffer(const std::string& filename, const std::string& content);
+
+  /*
+   *  The warnings of the selected rules on a parsed document.
+   */
+  std::vector<diagnostic> check(const document& d, unsigned int rules = all_rules);
+
+  /*
+   *  Parse and check at once: all the errors and warnings of a file.
+   */
+  std::vector<diagnostic> validate_file(const std::string& path,
+                                        unsigned int rules = all_rules);
+  std::vector<diagnostic> validate_buffer(const std::string& filename,
+                                          const std::string& content,
+                                          unsigned int rules = all_rules);
+
+  /*
+   *  The inputs and macros a document uses, with the macro file names
+   *  resolved in the macro directories. With the transitive variant,
+   *  the readable dependencies are parsed in turn, and each file is
+   *  listed once.
+   */
+  std::vector<dependency> get_dependencies(const document& d);
+  std::vector<dependency> get_transitive_dependencies(const std::string& path);
+
+private:
+  struct implementation;
+  std::unique_ptr<implementation> impl;
+};
+
+}
+
+#endif /* LIBALINT_H */
@@ -0,0 +1,158 @@
+#ifndef LIMITS_H
+#define LIMITS_H
+
+#include <string>
+#include <chrono>
+#include <cstdint>
+
+#include "file_utils.hpp"
+#include "diagnostics.hpp"
+
+
+/*
+ *  Limits on the work alint does for one file, 0 for no limit. The
+ *  timeout is in seconds. The lex errors reported are limited to
+ *  max_diagnostics too, or to a default number without it.
+ */
+struct resource_limits {
+  resource_limits()
+    : max_file_size(0), max_tokens(0), max_depth(0), max_diagnostics(0), timeout(0.0) {}
+
+  std::uint64_t max_file_size;
+  std::size_t max_tokens;
+  std::size_t max_depth;
+  std::size_t max_diagnostics;
+  double timeout;
+};
+
+
+/*
+ *  Thrown when a file exceeds a limit, or when the run is cancelled:
+ *  the analysis of the file stops, and the limit is reported at the
+ *  given position.
+ */
+struct limit_exceeded {
+  limit_exceeded(const std::string& filename, std::size_t line, std::size_t column,
+                 const std::string& message, bool cancelled = false)
+    : filename(filename), line(line), column(column),
+      message(message), cancelled(cancelled) {}
+
+  void report() const {
+    if (not cancelled)
+      report_diagnostic(diagnostic(filename, line, column, "error", message, "resource-limit"));
+  }
+
+  std::string filename;
+  std::size_t line;
+  std::size_t column;
+  std::string message;
+  bool cancelled;
+};
+
+
+/*
+ *  The work done so far on a file, counted token by token. The nesting
+ *  depth counts the open FOR, IF, MACRO and parentheses. The deadline
+ *  and the cancellation are checked every check_period tokens, and
+ *  between the phases of the analysis.
+ *
+ *  The checkers and printers recurse once per level of nesting, so the
+ *  depth is at most max_nesting, with or without a limit. The lists
+ *  and the operators of the expressions are not nesting: the visitors
+ *  follow them in a loop.
+ */
+class file_budget {
+public:
+  using clock = std::chrono::steady_clock;
+
+  file_budget(): tokens(0), depth(0) {}
+
+  void set_limits(const resource_limits& l) { limits = l; }
+  const resource_limits& get_limits() const { return limits; }
+
+  void start(const std::string& f) {
+    filename = f;
+    tokens = 0;
+    depth = 0;
+    deadline = clock::now() + std::chrono::duration_cast<clock::duration>(
+      std::chrono::duration<double>(limits.timeout));
+  }
+
+  void check_file_size() const {
+    check_file_size(filename);
+  }
+
+  /*
+   *  Before a file is read, and once it is in memory.
+   */
+  void check_file_size(const std::string& f) const {
+    check_size(f, get_file_size(f));
+  }
+
+  void check_size(const std::string& f, std::uint64_t size) const {
+    if (limits.max_file_size and size > limits.max_file_size)
+      throw limit_exceeded(f, 1, 0, "file larger than the limit of "
+                           + std::to_string(limits.max_file_size) + " bytes.");
+  }
+
+  void count(const token<symbol>& t) {
+    switch (t.symbol) {
+    case symbol::for_kw: case symbol::if_kw: case symbol::if_def_kw:
+    case symbol::defmacro_kw: case symbol::lp:
+      ++depth;
+      break;
+    case symbol::enddo_kw: case symbol::endif_kw:
+    case symbol::enddefmacro_kw: case symbol::rp:
+      if (depth)
+        --depth;
+      break;
+    default:
+      break;
+    }
+
+    ++tokens;
+    if (limits.max_tokens and tokens > limits.max_tokens)
+      exceed(t, "more tokens than the limit of " + std::to_string(limits.max_tokens) + ".");
+    if (depth > get_max_depth())
+      exceed(t, "nesting deeper than the limit of " + std::to_string(get_max_depth()) + ".");
+    if (tokens % check_period == 0)
+      check_time(&t);
+  }
+
+  std::size_t get_max_depth() const {
+    return limits.max_depth and limits.max_depth < max_nesting ? limits.max_depth : max_nesting;
+  }
+
+  void check_time(const token<symbol>* t = nullptr) const {
+    if (default_diagnostic_sink().failed())
+      throw limit_exceeded(filename, 1, 0, "cancelled.", true);
+
+    if (limits.timeout > 0.0 and clock::now() > deadline) {
+      std::ostringstream message;
+      message << "analysis longer than the limit of " << limits.timeout << "s.";
+      if (t)
+        exceed(*t, message.str());
+      throw limit_exceeded(filename, 1, 0, message.str());
+    }
+  }
+
+private:
+  static const std::size_t check_period = 1024;
+  static const std::size_t max_nesting = 1024;
+
+  void exceed(const token<symbol>& t, const std::string& message) const {
+    const file_source_coordinate_range* c(
+      dynamic_cast<const file_source_coordinate_range*>(t.get_coordinates()));
+    if (c)
+      throw limit_exceeded(c->get_filename(), c->get_line(), c->get_column(), message);
+    throw limit_exceeded(filename, 1, 0, message);
+  }
+
+  resource_limits limits;
+  std::string filename;
+  std::size_t tokens;
+  std::size_t depth;
+  clock::time_point deadline;
+};
+
+#endif /* LIMITS_H */
@@ -0,0 +1,542 @@
+#ifndef LSP_H
+#define LSP_H
+
+#include <map>
+#include <string>
+#include <vector>
+#include <istream>
+#include <ostream>
+#include <algorithm>
+#include <exception>
+#include <cctype>
+#include <cstdlib>
+
+#include "json.hpp"
+#include "diagnostics.hpp"
+#include "incremental.hpp"
+#include "range_format.hpp"
+
+
+/*
+ *  Language server protocol transport: messages are JSON documents
+ *  preceded by a Content-Length header.
+ */
+inline
+bool read_lsp_message(std::istream& stream, std::string& content) {
+  std::size_t length(0);
+  bool has_length(false);
+  std::string header;
+  while (std::getline(stream, header)) {
+    if (not header.empty() and header.back() == '\r')
+      header.pop_back();
+    if (header.empty()) {
+      if (has_length)
+        break;
+      continue;
+    }
+
+    const std::string name("Content-Length:");
+    if (header.compare(0, name.size(), name) == 0) {
+      length = std::strtoul(header.c_str() + name.size(), nullptr, 10);
+      has_length = true;
+    }
+  }
+
+  if (not has_length)
+    return false;
+
+  content.resize(length);
+  stream.read(&content[0], length);
+  return static_cast<std::size_t>(stream.gcount()) == length;
+}
+
+inline
+void write_lsp_message(std::ostream& stream, const json_value& message) {
+  const std::string content(message.dump());
+  stream << "Content-Length: " << content.size() << "\r\n\r\n" << content;
+  stream.flush();
+}
+
+inline
+std::string uri_to_path(const std::string& uri) {
+  const std::string scheme("file://");
+  std::string encoded(uri.compare(0, scheme.size(), scheme) == 0 ?
+                      uri.substr(scheme.size()) : uri);
+
+  std::string path;
+  for (std::size_t i(0); i < encoded.size(); ++i)
+    if (encoded[i] == '%' and i + 2 < encoded.size()) {
+      path += static_cast<char>(std::strtoul(encoded.substr(i + 1, 2).c_str(), nullptr, 16));
+      i += 2;
+    } else {
+      path += encoded[i];
+    }
+  return path;
+}
+
+inline
+std::string path_to_uri(const std::string& path) {
+  static const char* hex("0123456789ABCDEF");
+  std::string uri("file://");
+  for (const char c: path) {
+    const unsigned char u(c);
+    if (std::isalnum(u) or c == '/' or c == '-' or c == '_' or c == '.' or c == '~')
+      uri += c;
+    else {
+      uri += '%';
+      uri += hex[u >> 4];
+      uri += hex[u & 0xf];
+    }
+  }
+  return uri;
+}
+
+inline
+json_value lsp_position(std::size_t line, std::size_t column) {
+  return json_value::object()
+    .set("line", line > 0 ? line - 1 : 0)
+    .set("character", column);
+}
+
+inline
+json_value lsp_range(std::size_t line, std::size_t column, std::size_t length) {
+  return json_value::object()
+    .set("start", lsp_position(line, column))
+    .set("end", lsp_position(line, column + length));
+}
+
+/*
+ *  An LSP unsigned integer, which the client sends as any number:
+ *  clamped to [0, 2^32 - 1].
+ */
+inline
+std::size_t lsp_uinteger(const json_value& value) {
+  const double n(value.get_number());
+  return n > 0 ? static_cast<std::size_t>(std::min(n, 4294967295.0)) : 0;
+}
+
+/*
+ *  Offset in text of an LSP position. The characters are counted as
+ *  bytes, the macro files being ASCII.
+ */
+inline
+std::size_t lsp_offset(const std::string& text, const json_value& position) {
+  std::size_t offset(0);
+  for (std::size_t line(lsp_uinteger(position["line"])); line > 0; --line) {
+    const std::string::size_type newline(text.find('\n', offset));
+    if (newline == std::string::npos)
+      return text.size();
+    offset = newline + 1;
+  }
+
+  const std::string::size_type line_end(std::min(text.find('\n', offset), text.size()));
+  return std::min(offset + lsp_uinteger(position["character"]), line_end);
+}
+
+
+/*
+ *  Collects the macro_def nodes of a tree, nested or not.
+ */
+class macro_definition_finder: public basic_visitor {
+public:
+  virtual void visit(node& n) override {
+    if (n.get_production_id() == -1)
+      return;
+
+    if (n.get_symbol() == symbol::macro_def)
+      definitions.push_back(&n);
+
+    accept_chain_children(n, this);
+  }
+
+  virtual void visit(leaf&) override {}
+
+  std::vector<const node*> definitions;
+};
+
+
+/*
+ *  Finds the leaf at a given position, and the nodes leading to it.
+ */
+class leaf_locator: public basic_visitor {
+public:
+  leaf_locator(std::size_t line, std::size_t column)
+    : line(line), column(column), found(nullptr) {}
+
+  virtual void visit(node& n) override {
+    if (found or n.get_production_id() == -1)
+      return;
+
+    const std::size_t depth(path.size());
+    for (node* c(&n); c and c->get_production_id() != -1; ) {
+      node* next(c->get_chain_next());
+      path.push_back(c);
+      for (auto child: c->get_children()) {
+        if (child == next)
+          continue;
+        child->accept(this);
+        if (found)
+          return;
+      }
+      c = next;
+    }
+    path.resize(depth);
+  }
+
+  virtual void visit(leaf& l) override {
+    if (l.get_line() == line
+        and column >= l.get_column()
+        and column < l.get_column() + std::max<std::size_t>(l.get_value().size(), 1))
+      found = &l;
+  }
+
+  std::size_t line;
+  std::size_t column;
+  const leaf* found;
+  std::vector<const node*> path;
+};
+
+
+/*
+ *  Language server over the standard input and output. The documents
+ *  opened by the editor are kept in memory with their tree, which is
+ *  updated incrementally on each change and linted again.
+ */
+class language_server {
+public:
+  language_server(const options& opt, const resource_limits& limits,
+                  lr_parser<symbol>& p,
+                  const recovery_table& recovery)
+    : opt(opt), limits(limits), p(p), recovery(recovery), shutdown_requested(false) {}
+
+  ~language_server() {
+    for (auto& d: documents)
+      delete d.second.parser;
+  }
+
+  /*
+   *  Returns the exit status expected by the protocol.
+   */
+  int run(std::istream& input, std::ostream& output) {
+    std::string content;
+    while (read_lsp_message(input, content)) {
+      json_value message;
+      try {
+        message = json_value::parse(content);
+      }
+      catch (const std::string& e) {
+        respond_error(output, json_value(), -32700, e);
+        continue;
+      }
+
+      const json_value& id(message["id"]);
+      try {
+        const std::string method(message["method"].get_string());
+        const json_value& params(message["params"]);
+
+        if (method == "initialize") {
+          respond(output, id, json_value::object()
+                  .set("capabilities", json_value::object()
+                       .set("textDocumentSync", 2)
+                       .set("documentSymbolProvider", true)
+                       .set("definitionProvider", true)
+                       .set("documentRangeFormattingProvider", true))
+                  .set("serverInfo", json_value::object().set("name", "alint")));
+        } else if (method == "shutdown") {
+          shutdown_requested = true;
+          respond(output, id, json_value());
+        } else if (method == "exit") {
+          return shutdown_requested ? 0 : 1;
+        } else if (method == "textDocument/didOpen") {
+          const json_value& document(params["textDocument"]);
+          const std::string uri(document["uri"].get_string());
+          update(output, uri, [&](incremental_parser& parser) {
+              parser.set_text(uri_to_path(uri), document["text"].get_string());
+            });
+        } else if (method == "textDocument/didChange") {
+          const std::vector<json_value>& changes(params["contentChanges"].get_array());
+          update(output, params["textDocument"]["uri"].get_string(), [&](incremental_parser& parser) {
+              for (const auto& change: changes)
+                apply_change(parser, change);
+            });
+        } else if (method == "textDocument/didClose") {
+          close(output, params["textDocument"]["uri"].get_string());
+        } else if (method == "textDocument/documentSymbol") {
+          respond(output, id, document_symbols(params["textDocument"]["uri"].get_string()));
+        } else if (method == "textDocument/definition") {
+          respond(output, id, definition(params["textDocument"]["uri"].get_string(),
+                                         lsp_uinteger(params["position"]["line"]) + 1,
+                                         lsp_uinteger(params["position"]["character"])));
+        } else if (method == "textDocument/rangeFormatting") {
+          respond(output, id, range_formatting(params["textDocument"]["uri"].get_string(),
+                                               params["range"]));
+        } else if (not id.is_null()) {
+          respond_error(output, id, -32601, "method not found: " + method);
+        }
+      }
+      catch (const std::string& e) {
+        respond_error(output, id, -32603, e);
+      }
+      catch (const limit_exceeded& e) {
+        respond_error(output, id, -32603, e.message);
+      }
+      catch (const std::exception& e) {
+        respond_error(output, id, -32603, e.what());
+      }
+      catch (...) {
+        respond_error(output, id, -32603, "internal error.");
+      }
+    }
+
+    return 1;
+  }
+
+private:
+  struct document {
+    document(): parser(nullptr) {}
+
+    std::string path;
+    incremental_parser* parser;
+  };
+
+  options opt;
+  resource_limits limits;
+  lr_parser<symbol>& p;
+  const recovery_table& recovery;
+  std::map<std::string, document> documents;
+  bool shutdown_requested;
+
+  static void respond(std::ostream& output, const json_value& id, const json_value& result) {
+    write_lsp_message(output, json_value::object()
+                      .set("jsonrpc", "2.0")
+                      .set("id", id)
+                      .set("result", result));
+  }
+
+  static void respond_error(std::ostream& output, const json_value& id,
+                            int code, const std::string& message) {
+    write_lsp_message(output, json_value::object()
+                      .set("jsonrpc", "2.0")
+                      .set("id", id)
+                      .set("error", json_value::object()
+                           .set("code", code)
+                           .set("message", message)));
+  }
+
+  /*
+   *  A change replaces the range it carries, or the whole text.
+   */
+  static void apply_change(incremental_parser& parser, const json_value& change) {
+    const json_value& range(change["range"]);
+    if (range.is_null()) {
+      parser.set_text(parser.get_filename(), change["text"].get_string());
+    } else {
+      const std::size_t begin(lsp_offset(parser.get_text(), range["start"]));
+      const std::size_t end(lsp_offset(parser.get_text(), range["end"]));
+      parser.update(begin, std::max(begin, end), change["text"].get_string());
+    }
+  }
+
+  template<typename edit_type>
+  void update(std::ostream& output, const std::string& uri, edit_type edit) {
+    document& d(documents[uri]);
+    if (not d.parser) {
+      d.path = uri_to_path(uri);
+      d.parser = new incremental_parser(p, recovery);
+      d.parser->set_limits(limits);
+    }
+
+    std::vector<diagnostic> diagnostics;
+    std::vector<diagnostic>* previous_collector(diagnostic_collector());
+    diagnostic_collector() = &diagnostics;
+
+    try {
+      edit(*d.parser);
+
+      const std::vector<diagnostic>& errors(d.parser->get_parse_errors());
+      diagnostics.insert(diagnostics.end(), errors.begin(), errors.end());
+      if (d.parser->get_tree()) {
+        check_do_enddo_guards(d.parser->get_tree());
+        check_white_spaces(d.parser->get_tree(), d.parser->get_white_spaces());
+      }
+    }
+    catch (const std::string& e) {
+      diagnostics.push_back(diagnostic(d.path, 1, 0, "error", e));
+    }
+    catch (const limit_exceeded& e) {
+      diagnostics.push_back(diagnostic(e.filename, e.line, e.column, "error", e.message,
+                                       "resource-limit"));
+    }
+    catch (...) {
+      diagnostic_collector() = previous_collector;
+      throw;
+    }
+
+    diagnostic_collector() = previous_collector;
+    publish(output, uri, diagnostics);
+  }
+
+  void close(std::ostream& output, const std::string& uri) {
+    auto item(documents.find(uri));
+    if (item == documents.end())
+      return;
+
+    delete item->second.parser;
+    documents.erase(item);
+    publish(output, uri, std::vector<diagnostic>());
+  }
+
+  void publish(std::ostream& output, const std::string& uri,
+               const std::vector<diagnostic>& diagnostics) {
+    json_value list(json_value::array());
+    for (const auto& d: diagnostics) {
+      json_value item(json_value::object()
+                      .set("range", lsp_range(d.line, d.column, 1))
+                      .set("severity", d.severity == "error" ? 1 : 2)
+                      .set("source", "alint")
+                      .set("message", d.message));
+      if (not d.rule.empty())
+        item.set("code", d.rule);
+      list.push_back(item);
+    }
+
+    write_lsp_message(output, json_value::object()
+                      .set("jsonrpc", "2.0")
+                      .set("method", "textDocument/publishDiagnostics")
+                      .set("params", json_value::object()
+                           .set("uri", uri)
+                           .set("diagnostics", list)));
+  }
+
+  static json_value leaf_range(const leaf* l) {
+    return lsp_range(l->get_line(), l->get_column(), l->get_value().size());
+  }
+
+  static json_value node_range(const basic_node* n) {
+    const leaf* first(n->get_first_leaf());
+    const leaf* last(n->get_last_leaf());
+    return json_value::object()
+      .set("start", lsp_position(first->get_line(), first->get_column()))
+      .set("end", lsp_position(last->get_line(), last->get_column() + last->get_value().size()));
+  }
+
+  json_value document_symbols(const std::string& uri) {
+    json_value symbols(json_value::array());
+    auto item(documents.find(uri));
+    if (item == documents.end() or not item->second.parser->get_tree())
+      return symbols;
+
+    macro_definition_finder finder;
+    item->second.parser->get_tree()->accept(&finder);
+    for (const auto n: finder.definitions) {
+      const basic_node* name(n->get_children()[1]);
+      symbols.push_back(json_value::object()
+                        .set("name", name->get_first_leaf()->get_value())
+                        .set("kind", 12)
+                        .set("range", node_range(n))
+                        .set("selectionRange", leaf_range(name->get_first_leaf())));
+    }
+    return symbols;
+  }
+
+  /*
+   *  The edits reformatting the statements overlapping the lines of
+   *  the range. Only the statements from the one containing the start
+   *  of the range are walked.
+   */
+  json_value range_formatting(const std::string& uri, const json_value& range) {
+    json_value edits(json_value::array());
+    auto item(documents.find(uri));
+    if (item == documents.end())
+      return edits;
+    const incremental_parser& parser(*item->second.parser);
+    if (not parser.get_tree() or parser.has_lex_errors() or parser.get_parse_errors().size())
+      return edits;
+
+    const std::size_t first_line(lsp_uinteger(range["start"]["line"]) + 1);
+    std::size_t last_line(lsp_uinteger(range["end"]["line"]) + 1);
+    if (last_line > first_line and range["end"]["character"].get_number() == 0)
+      --last_line;
+
+    const json_value line_start(json_value::object()
+                                .set("line", first_line - 1)
+                                .set("character", 0));
+    const leaf* before(nullptr);
+    node* statements(parser.statements_from(lsp_offset(parser.get_text(), line_start), before));
+    if (not statements)
+      return edits;
+
+    range_formatter formatter(parser.get_white_spaces(), first_line, last_line);
+    formatter.format(statements, before);
+    for (const auto& e: formatter.get_edits())
+      edits.push_back(json_value::object()
+                      .set("range", json_value::object()
+                           .set("start", lsp_position(e.first_line, e.first_column))
+                           .set("end", lsp_position(e.last_line, e.last_column)))
+                      .set("newText", e.text));
+    return edits;
+  }
+
+  std::string resolve_input(const std::string& document_path, const std::string& filename) const {
+    if (filename.empty() or filename[0] == '/')
+      return filename;
+
+    const std::string::size_type slash(document_path.rfind('/'));
+    if (slash != std::string::npos) {
+      const std::string sibling(document_path.substr(0, slash + 1) + filename);
+      if (get_modification_time(sibling))
+        return sibling;
+    }
+    return canonical_path(filename);
+  }
+
+  static json_value file_location(const std::string& path) {
+    return json_value::object()
+      .set("uri", path_to_uri(path))
+      .set("range", lsp_range(1, 0, 0));
+  }
+
+  json_value definition(const std::string& uri, std::size_t line, std::size_t column) {
+    auto item(documents.find(uri));
+    if (item == documents.end() or not item->second.parser->get_tree())
+      return json_value();
+
+    leaf_locator locator(line, column);
+    item->second.parser->get_tree()->accept(&locator);
+    if (not locator.found)
+      return json_value();
+
+    const leaf* l(locator.found);
+    switch (l->get_symbol()) {
+    case symbol::global_macro_name:
+      return file_location(opt.global_macro_dir + l->get_value());
+
+    case symbol::local_macro_name:
+      return file_location(opt.local_macro_dir + l->get_value());
+
+    case symbol::inline_macro_name: {
+      macro_definition_finder finder;
+      item->second.parser->get_tree()->accept(&finder);
+      for (const auto n: finder.definitions) {
+        const leaf* name(n->get_children()[1]->get_first_leaf());
+        if (name->get_value() == l->get_value())
+          return json_value::object()
+            .set("uri", uri)
+            .set("range", leaf_range(name));
+      }
+    }
+      break;
+
+    default:
+      for (const auto n: locator.path)
+        if (n->get_symbol() == symbol::input)
+          return file_location(resolve_input(item->second.path,
+                                             get_input_filename(const_cast<node*>(n))));
+      break;
+    }
+
+    return json_value();
+  }
+};
+
+#endif /* LSP_H */
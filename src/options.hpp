@@ -1,6 +1,11 @@
 #ifndef _OPTIONS_H_
 #define _OPTIONS_H_
 
+#include <string>
+#include <vector>
+#include <ostream>
+#include <cstdlib>
+
 struct options {
   options() :
     lexing_pass(false),
@@ -11,19 +16,44 @@ struct options {
     verbose(false),
     silent(false),
     reformat_source(false),
+    check_format(false),
+    in_place(false),
+    range_format(false),
+    range_in_bytes(false),
+    range_first(0),
+    range_last(0),
     html_highlight(false),
-    recursive_parse(false) {
+    recursive_parse(false),
+    watch(false),
+    server(false),
+    client(false),
+    language_server(false),
+    stats(false),
+    allocations(false),
+    fail_fast(false),
+    colors(false),
+    jobs(0),
+    format("text"),
+    max_file_size(0),
+    max_tokens(0),
+    max_depth(0),
+    max_diagnostics(0),
+    timeout(0.0) {
     const char* g_m_dir(std::getenv("ALUCELL_GLOBAL_MACRO_DIR"));
     if (g_m_dir)
       global_macro_dir = g_m_dir;
-    else
-      std::cout << "warning: environment variable ALUCELL_GLOBAL_MACRO_DIR is not set." << std::endl;
     
     const char* l_m_dir(std::getenv("ALUCELL_LOCAL_MACRO_DIR"));
     if (l_m_dir)
       local_macro_dir = l_m_dir;
-    else
-      std::cout << "warning: environment variable ALUCELL_LOCAL_MACRO_DIR is not set." << std::endl;
+  }
+
+  void warn_about_environment(std::ostream& stream) const {
+    if (not std::getenv("ALUCELL_GLOBAL_MACRO_DIR"))
+      stream << "warning: environment variable ALUCELL_GLOBAL_MACRO_DIR is not set." << std::endl;
+
+    if (not std::getenv("ALUCELL_LOCAL_MACRO_DIR"))
+      stream << "warning: environment variable ALUCELL_LOCAL_MACRO_DIR is not set." << std::endl;
   }
 
   bool lexing_pass;
@@ -34,11 +64,62 @@ struct options {
   bool verbose;
   bool silent;
   bool reformat_source;
+  bool check_format;
+  bool in_place;
+
+  /*
+   *  The range reformatted by -f: lines from 1, both included, or with
+   *  --bytes, offsets from 0, the last one excluded.
+   */
+  bool range_format;
+  bool range_in_bytes;
+  std::size_t range_first;
+  std::size_t range_last;
+
   bool html_highlight;
   bool recursive_parse;
+  bool watch;
+  bool server;
+  bool client;
+  bool language_server;
+  bool stats;
+  bool allocations;
+  bool fail_fast;
+
+  /*
+   *  Whether the text diagnostics are colored, when they go to a
+   *  terminal.
+   */
+  bool colors;
+
+  /*
+   *  The number of threads, 0 when not given: the files are then
+   *  reformatted in place on one thread per core, and linted on one
+   *  thread.
+   */
+  std::size_t jobs;
+  std::string format;
+
+  /*
+   *  Limits per file, 0 for no limit. The depth is at most 1024
+   *  anyway.
+   */
+  std::size_t max_file_size;
+  std::size_t max_tokens;
+  std::size_t max_depth;
+  std::size_t max_diagnostics;
+  double timeout;
 
   std::string global_macro_dir;
   std::string local_macro_dir;
+
+  std::string dependency_index;
+  std::vector<std::string> reverse_dependencies;
+  std::string changed_revisions;
+  std::string socket_path;
+  std::string files_from;
+  std::string trace;
+  std::string site;
 };
 
 #endif /* _OPTIONS_H_ */
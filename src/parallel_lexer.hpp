@@ -0,0 +1,231 @@
+#ifndef PARALLEL_LEXER_H
+#define PARALLEL_LEXER_H
+
+#include <string>
+#include <vector>
+#include <thread>
+#include <fstream>
+#include <sstream>
+#include <algorithm>
+
+
+/*
+ *  Offsets of the line starts where the text is cut in about equal
+ *  chunks. Comments and shell escapes end with their line, and only
+ *  literal strings (and DO/ENDDO labels) may span several lines: a
+ *  line start is a candidate when an even number of quotes precede
+ *  it, not counting those of comments. The last offset is the size of
+ *  the text.
+ */
+std::vector<std::size_t> find_chunk_bounds(const std::string& text, std::size_t chunks) {
+  const std::size_t chunk_size(text.size() / chunks + 1);
+  const std::string word_characters("abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ0123456789_./'");
+  std::vector<std::size_t> bounds(1, 0);
+
+  std::size_t i(0);
+  while (bounds.size() < chunks and i < text.size()) {
+    i = text.find_first_of("\"#!\n", i);
+    if (i == std::string::npos)
+      break;
+
+    switch (text[i]) {
+    case '"':
+      i = text.find('"', i + 1);
+      if (i == std::string::npos)
+        i = text.size();
+      break;
+
+    case '#':
+      /*
+       *  #{...} within an identifier is not a comment.
+       */
+      if (i + 1 < text.size() and text[i + 1] == '{'
+          and i > 0 and word_characters.find(text[i - 1]) != std::string::npos) {
+        i = text.find('}', i);
+        if (i == std::string::npos)
+          i = text.size();
+        break;
+      }
+      /* fall through */
+    case '!':
+      i = text.find('\n', i);
+      if (i == std::string::npos)
+        i = text.size();
+      continue;
+
+    case '\n':
+      if (i + 1 >= bounds.back() + chunk_size and i + 1 < text.size())
+        bounds.push_back(i + 1);
+      break;
+    }
+    ++i;
+  }
+
+  bounds.push_back(text.size());
+  return bounds;
+}
+
+
+/*
+ *  Tokens of the chunk [begin, end) of a text, and whether they are
+ *  those a sequential lexer gives.
+ */
+struct lexed_chunk {
+  std::vector<token<symbol>*> lexems;
+  std::vector<std::string> white_spaces;
+  std::size_t last_token_end;
+  bool complete;
+};
+
+/*
+ *  Lex from begin, which is the start of the line first_line, up to
+ *  the last token before end. The lexer sees the rest of the text,
+ *  and stops once only white spaces remain up to end. Since it has no
+ *  state besides its position, the chunk starting at end then goes on
+ *  exactly where this one stops. When a token spans end instead, or
+ *  on lex errors, the chunk is not complete.
+ */
+void lex_chunk(const std::string& filename, const std::string& text,
+               std::size_t begin, std::size_t end, std::size_t first_line,
+               lexed_chunk& chunk) {
+  using token_type = token<symbol>;
+  trace_span span("lex chunk", filename);
+
+  const std::string padding(first_line - 1, '\n');
+  padded_streambuf buffer(padding, text.data() + begin, text.data() + text.size());
+  std::istream stream(&buffer);
+  file_source<token_type> source(&stream, filename);
+  regex_lexer<token_type> lexer(build_alint_lexer());
+  lexer.set_source(&source);
+
+  std::size_t cursor(begin);
+  chunk.complete = false;
+  try {
+    while (end == text.size() or text.find_first_not_of(" \t\n\r", cursor) < end) {
+      token_type* t(lexer.get());
+      std::string skipped(lexer.get_skipped_characters());
+      if (chunk.lexems.empty())
+        skipped.erase(0, padding.size());
+
+      cursor += skipped.size() + t->value.size();
+      chunk.lexems.push_back(t);
+      chunk.white_spaces.push_back(skipped);
+
+      if (t->symbol == symbol::eoi)
+        break;
+      if (cursor > end or default_diagnostic_sink().failed())
+        return;
+    }
+  }
+  catch (const lex_error&) {
+    return;
+  }
+
+  chunk.last_token_end = cursor;
+  chunk.complete = true;
+}
+
+
+/*
+ *  Lex a whole text on several threads, in chunks cut at line starts.
+ *  The tokens and white spaces of the chunks are merged in the arrays
+ *  a sequential lexer would give, so that the lexem ids are the same.
+ *
+ *  Returns false, leaving lexems and white_spaces untouched, when the
+ *  text is too small, or when a chunk isn't complete. The text has to
+ *  be lexed sequentially then, which also reports the lex errors.
+ */
+bool lex_in_parallel(const std::string& filename, const std::string& text, std::size_t jobs,
+                     std::vector<token<symbol>*>& lexems,
+                     std::vector<std::string>& white_spaces) {
+  const std::size_t minimum_chunk_size(1 << 16);
+  if (jobs < 2 or text.size() < 2 * minimum_chunk_size)
+    return false;
+
+  const std::vector<std::size_t> bounds(
+    find_chunk_bounds(text, std::min(jobs, text.size() / minimum_chunk_size)));
+  const std::size_t chunks(bounds.size() - 1);
+  if (chunks < 2)
+    return false;
+
+  std::vector<std::size_t> first_lines(1, 1);
+  for (std::size_t c(1); c < chunks; ++c)
+    first_lines.push_back(first_lines.back() + std::count(text.begin() + bounds[c - 1],
+                                                          text.begin() + bounds[c], '\n'));
+
+  std::vector<lexed_chunk> lexed(chunks);
+  std::vector<std::thread> threads;
+  for (std::size_t c(0); c < chunks; ++c)
+    threads.push_back(std::thread(lex_chunk, std::cref(filename), std::cref(text),
+                                  bounds[c], bounds[c + 1], first_lines[c], std::ref(lexed[c])));
+  for (auto& t: threads)
+    t.join();
+
+  bool complete(true);
+  std::size_t size(0);
+  for (const auto& chunk: lexed) {
+    complete = complete and chunk.complete;
+    size += chunk.lexems.size();
+  }
+
+  if (not complete) {
+    for (auto& chunk: lexed)
+      for (auto t: chunk.lexems)
+        delete t;
+    return false;
+  }
+
+  /*
+   *  The white spaces between the last token of a chunk and the end of
+   *  the chunk belong to the first token of the next ones.
+   */
+  lexems.reserve(size);
+  white_spaces.reserve(size);
+  std::string carried;
+  for (std::size_t c(0); c < chunks; ++c) {
+    lexed_chunk& chunk(lexed[c]);
+    for (std::size_t i(0); i < chunk.lexems.size(); ++i) {
+      lexems.push_back(chunk.lexems[i]);
+      if (i == 0 and not carried.empty()) {
+        white_spaces.push_back(carried + chunk.white_spaces[i]);
+        carried.clear();
+      } else {
+        white_spaces.push_back(std::move(chunk.white_spaces[i]));
+      }
+    }
+    if (c + 1 < chunks)
+      carried += text.substr(chunk.last_token_end, bounds[c + 1] - chunk.last_token_end);
+  }
+  return true;
+}
+
+
+/*
+ *  Read a file and lex it on several threads, or sequentially when it
+ *  can't be. The size of the file is checked against the limits of
+ *  tokens before it is read.
+ */
+void lex_file_in_parallel(alint_token_source& tokens, const std::string& filename, std::size_t jobs) {
+  tokens.get_budget().check_file_size(filename);
+  std::ifstream file(filename.c_str(), std::ios::in);
+  if (not file) {
+    tokens.set_file(filename);
+    return;
+  }
+
+  std::ostringstream content;
+  content << file.rdbuf();
+  const std::string text(content.str());
+  tokens.get_budget().check_size(filename, text.size());
+
+  std::vector<token<symbol>*> lexems;
+  std::vector<std::string> white_spaces;
+  if (lex_in_parallel(filename, text, jobs, lexems, white_spaces)) {
+    tokens.set_lexems(filename, std::move(lexems), std::move(white_spaces));
+  } else {
+    tokens.set_buffer(filename, text);
+    tokens.lex_to_end();
+  }
+}
+
+#endif /* PARALLEL_LEXER_H */
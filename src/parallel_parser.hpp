@@ -0,0 +1,183 @@
+#ifndef PARALLEL_PARSER_H
+#define PARALLEL_PARSER_H
+
+#include <string>
+#include <vector>
+#include <thread>
+#include <algorithm>
+
+
+/*
+ *  Indices of the tokens which start a top level statement, by their
+ *  kind, and which are good places to cut the token stream in chunks.
+ *  The nesting of IF/ENDIF, FOR/ENDDO and MACRO/ENDMACRO is tracked;
+ *  outside of any of them, comments, shell escapes, inputs, and the
+ *  first token of these blocks can only start a statement. So can a
+ *  parenthesis outside of any parentheses, when it does not open the
+ *  arguments of a macro call.
+ */
+std::vector<std::size_t> find_statement_starts(const std::vector<token<symbol>*>& lexems) {
+  std::vector<std::size_t> starts;
+  long depth(0), parentheses(0);
+  for (std::size_t i(0); i < lexems.size(); ++i) {
+    const symbol s(lexems[i]->symbol);
+    const bool top_level(depth == 0 and parentheses == 0);
+
+    switch (s) {
+    case symbol::comment:
+    case symbol::visual_comment:
+    case symbol::shell_escape:
+    case symbol::at:
+      if (top_level)
+        starts.push_back(i);
+      break;
+
+    case symbol::if_kw:
+    case symbol::if_def_kw:
+    case symbol::for_kw:
+    case symbol::defmacro_kw:
+      if (top_level)
+        starts.push_back(i);
+      ++depth;
+      break;
+
+    case symbol::endif_kw:
+    case symbol::enddo_kw:
+    case symbol::enddefmacro_kw:
+      --depth;
+      break;
+
+    case symbol::lp:
+      if (top_level and i > 0
+          and lexems[i - 1]->symbol != symbol::inline_macro_name
+          and lexems[i - 1]->symbol != symbol::global_macro_name
+          and lexems[i - 1]->symbol != symbol::local_macro_name)
+        starts.push_back(i);
+      ++parentheses;
+      break;
+
+    case symbol::rp:
+      --parentheses;
+      break;
+
+    default:
+      break;
+    }
+  }
+  return starts;
+}
+
+
+/*
+ *  Parse the tokens of a whole file, up to its eoi token, on several
+ *  threads. The file is cut in chunks at top level statements, each
+ *  chunk is parsed followed by the final endmacro, with the same
+ *  parser tables, and the stmt_list of the chunks are stitched in one
+ *  macro_file tree. The lexem ids are those of a sequential parse.
+ *
+ *  When the file is too small, or a chunk does not parse, the whole
+ *  file is parsed sequentially, and its errors are given to handler.
+ */
+template<typename handler_type>
+basic_node* parse_in_parallel(const lr_parser<symbol>& p,
+                              const recovery_table& recovery,
+                              const std::vector<token<symbol>*>& lexems,
+                              std::size_t jobs,
+                              handler_type& handler) {
+  using token_type = token<symbol>;
+  const std::size_t minimum_chunk_size(2048);
+  const std::size_t n(lexems.size());
+
+  auto sequential([&]() {
+      token_replay_source input(lexems.data(), lexems.data() + n, 1);
+      tree_factory<symbol> factory;
+      return parse_input_with_recovery(p, recovery, input, factory, handler);
+    });
+
+  if (jobs < 2 or n < 2 * minimum_chunk_size
+      or lexems[n - 2]->symbol != symbol::endmacro_kw)
+    return sequential();
+
+  /*
+   *  Chunk c covers the tokens [bounds[c], bounds[c + 1]).
+   */
+  const std::vector<std::size_t> starts(find_statement_starts(lexems));
+  const std::size_t chunk_size(std::max(minimum_chunk_size, (n - 2) / jobs));
+  std::vector<std::size_t> bounds(1, 0);
+  for (const auto s: starts)
+    if (s >= bounds.back() + chunk_size and s + minimum_chunk_size / 2 < n - 2)
+      bounds.push_back(s);
+  bounds.push_back(n - 2);
+
+  const std::size_t chunks(bounds.size() - 1);
+  if (chunks < 2)
+    return sequential();
+
+  std::vector<basic_node*> roots(chunks, nullptr);
+  std::vector<std::thread> threads;
+  for (std::size_t c(0); c < chunks; ++c)
+    threads.push_back(std::thread([&, c]() {
+          trace_span span("parse chunk");
+          try {
+            token_replay_source input(lexems.data() + bounds[c], lexems.data() + bounds[c + 1],
+                                      bounds[c] + 1, lexems[n - 2], lexems[n - 1]);
+            tree_factory<symbol> factory;
+            silent_error_handler<token_type> chunk_handler;
+            basic_node* root(parse_input_with_recovery(p, recovery, input, factory, chunk_handler));
+            if (not chunk_handler.status) {
+              delete root;
+              root = nullptr;
+            }
+            roots[c] = root;
+          }
+          catch (...) {
+            roots[c] = nullptr;
+          }
+        }));
+  for (auto& t: threads)
+    t.join();
+
+  /*
+   *  The spine of each chunk, and the stmt_list -> stmt stmt_list
+   *  production id to join them.
+   */
+  std::vector<std::vector<node*> > spines(chunks);
+  int pair_rule(-1);
+  bool complete(true);
+  for (std::size_t c(0); c < chunks and complete; ++c) {
+    node* macro_file(find_macro_file(roots[c]));
+    complete = macro_file and macro_file->get_children().size() == 2;
+    if (complete)
+      append_statement_spine(static_cast<node*>(macro_file->get_children()[0]), spines[c], pair_rule);
+  }
+
+  if (not complete or pair_rule < 0) {
+    for (auto r: roots)
+      delete r;
+    return sequential();
+  }
+
+  /*
+   *  The tree of the last chunk ends with the endmacro of the file,
+   *  with its lexem id: the stmt_list of the other chunks are moved
+   *  in front of its own.
+   */
+  for (std::size_t c(chunks - 1); c-- > 0;) {
+    std::vector<node*>& spine(spines[c]);
+    node* last(spine.back());
+    std::vector<basic_node*> children{last->replace_child(0, nullptr), spines[c + 1].front()};
+    node* joined(new node(symbol::stmt_list, pair_rule, children.begin(), children.end()));
+    delete last;
+    if (spine.size() > 1)
+      spine[spine.size() - 2]->replace_child(1, joined);
+    spine.back() = joined;
+
+    find_macro_file(roots[c])->replace_child(0, nullptr);
+    delete roots[c];
+  }
+
+  find_macro_file(roots.back())->replace_child(0, spines.front().front());
+  return roots.back();
+}
+
+#endif /* PARALLEL_PARSER_H */
@@ -0,0 +1,138 @@
+#ifndef PARSE_CACHE_H
+#define PARSE_CACHE_H
+
+#include <map>
+#include <list>
+#include <string>
+#include <vector>
+#include <utility>
+#include <cstdint>
+
+#include "file_utils.hpp"
+
+
+struct parsed_file {
+  parsed_file(): tree(nullptr), mtime(0), recovered(false), lex_errors(false) {}
+
+  basic_node* tree;
+  std::vector<std::string> white_spaces;
+  std::int64_t mtime;
+  bool recovered;
+  bool lex_errors;
+};
+
+
+/*
+ *  Syntax trees of the files parsed so far, invalidated when the
+ *  modification time of the file changes.
+ *
+ *  The entries are keyed by the canonical file name and by the name
+ *  the file has been opened with, since the latter ends up in the
+ *  coordinates of the tree leaves. At most capacity trees are kept,
+ *  the least recently used ones are released first.
+ */
+class parse_cache {
+public:
+  using token_type = token<symbol>;
+
+  parse_cache(std::size_t capacity = 4096): capacity(capacity) {}
+  parse_cache(const parse_cache&) = delete;
+  parse_cache& operator=(const parse_cache&) = delete;
+
+  ~parse_cache() {
+    clear();
+  }
+
+  /*
+   *  Returns the cached tree of the file, or parses it. The syntax
+   *  errors are given to handler, and a parse_error it throws is
+   *  propagated to the caller, with nothing cached for the file. A tree
+   *  recovered from errors, or of a file with lexical errors, is parsed
+   *  again on the next call, so that its errors are given again.
+   */
+  template<typename handler_type>
+  const parsed_file& get(const std::string& filename,
+                         lr_parser<symbol>& p,
+                         const recovery_table& recovery,
+                         alint_token_source& tokens,
+                         handler_type& handler) {
+    const key_type key(canonical_path(filename), filename);
+    const std::int64_t mtime(get_modification_time(filename));
+    auto item(files.find(key));
+    if (item != files.end()) {
+      if (item->second.file.mtime == mtime and mtime != 0
+          and not item->second.file.recovered and not item->second.file.lex_errors) {
+        recently_used.splice(recently_used.begin(), recently_used, item->second.use);
+        return item->second.file;
+      }
+      erase(item);
+    }
+
+    tokens.set_file(filename);
+    tree_factory<symbol> factory;
+    bool recovered(false);
+    auto recovering_handler([&](const parse_error<token_type>& e) {
+        recovered = true;
+        handler(e);
+      });
+    basic_node* tree(parse_input_with_recovery(p, recovery, tokens, factory, recovering_handler));
+    if (not tree)
+      throw std::string(filename + ": parse failed");
+
+    while (files.size() and files.size() >= capacity)
+      erase(files.find(recently_used.back()));
+
+    recently_used.push_front(key);
+    entry& result(files[key]);
+    result.use = recently_used.begin();
+    result.file.tree = tree;
+    result.file.white_spaces = tokens.get_white_spaces();
+    result.file.mtime = mtime;
+    result.file.recovered = recovered;
+    result.file.lex_errors = tokens.has_lex_errors();
+    return result.file;
+  }
+
+  const parsed_file& get(const std::string& filename,
+                         lr_parser<symbol>& p,
+                         const recovery_table& recovery,
+                         alint_token_source& tokens) {
+    default_error_handler<token_type> handler;
+    return get(filename, p, recovery, tokens, handler);
+  }
+
+  void erase(const std::string& filename) {
+    auto item(files.find(key_type(canonical_path(filename), filename)));
+    if (item != files.end())
+      erase(item);
+  }
+
+  void clear() {
+    for (auto& f: files)
+      delete f.second.file.tree;
+    files.clear();
+    recently_used.clear();
+  }
+
+  std::size_t size() const { return files.size(); }
+
+private:
+  using key_type = std::pair<std::string, std::string>;
+
+  struct entry {
+    parsed_file file;
+    std::list<key_type>::iterator use;
+  };
+
+  std::size_t capacity;
+  std::map<key_type, entry> files;
+  std::list<key_type> recently_used;
+
+  void erase(std::map<key_type, entry>::iterator item) {
+    delete item->second.file.tree;
+    recently_used.erase(item->second.use);
+    files.erase(item);
+  }
+};
+
+#endif /* PARSE_CACHE_H */
@@ -131,15 +131,17 @@ public:
   using token_type = token<symbol_type>;
   using node_type = basic_node;
   
-  node_type* build_node(std::list<node_type*>::iterator begin,
-                        std::list<node_type*>::iterator end,
+  template<typename iterator_type>
+  node_type* build_node(iterator_type begin,
+                        iterator_type end,
                         int rule_id,
                         symbol_type symbol) {
 
     return new node(symbol, rule_id, begin, end);
   }
 
-  node_type* build_leaf(alint_token_source& src) {
+  template<typename source_type>
+  node_type* build_leaf(source_type& src) {
     return new leaf(src.get().symbol, src.get().value,
                     src.get().get_coordinates()->copy(),
                     src.get_lexem_id());
@@ -147,4 +149,66 @@ public:
 };
 
 
+/*
+ *  The macro_file node of a tree, which is the root or its first
+ *  descendant on the left, if any.
+ */
+node* find_macro_file(basic_node* n) {
+  while (n and n->get_symbol() != symbol::macro_file) {
+    node* inner(dynamic_cast<node*>(n));
+    if (not inner or inner->get_children().empty())
+      return nullptr;
+    n = inner->get_children().front();
+  }
+  return static_cast<node*>(n);
+}
+
+/*
+ *  Append the stmt_list nodes of the spine starting at n, one per top
+ *  level statement. pair_rule is set to the production id of the
+ *  stmt_list -> stmt stmt_list nodes met.
+ */
+void append_statement_spine(node* n, std::vector<node*>& spine, int& pair_rule) {
+  while (n) {
+    spine.push_back(n);
+    if (n->get_children().size() == 2) {
+      pair_rule = n->get_production_id();
+      n = static_cast<node*>(n->get_children()[1]);
+    } else {
+      n = nullptr;
+    }
+  }
+}
+
+
+template<typename token_type>
+struct silent_error_handler: public default_error_handler<token_type> {
+public:
+  silent_error_handler() : status(true) {}
+  virtual ~silent_error_handler() {}
+  
+  virtual void operator()(const parse_error<token_type>&) {
+    status = false;
+  }
+
+  bool status;
+};
+
+
+std::string parse_error_message(const parse_error<token<symbol> >& e) {
+  std::ostringstream message;
+  message << "unexpected " << e.get_unexpected_token().symbol;
+
+  if (e.get_unexpected_token().value.size())
+    message << " (" << e.get_unexpected_token().value << ")";
+
+  if (e.get_expected_symbols().size() == 1)
+    message << " instead of a " << e.get_expected_symbols().front() << ".";
+  else
+    message << ".";
+
+  return message.str();
+}
+
+
 #endif /* ALINT_PARSER_H */
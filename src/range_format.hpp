@@ -0,0 +1,167 @@
+#ifndef RANGE_FORMAT_H
+#define RANGE_FORMAT_H
+
+#include <string>
+#include <vector>
+#include <sstream>
+#include <algorithm>
+
+
+/*
+ *  Replace the text from the first position up to the last one,
+ *  excluded, by text. The lines start at 1 and the columns at 0.
+ */
+struct text_edit {
+  text_edit(std::size_t first_line, std::size_t first_column,
+            std::size_t last_line, std::size_t last_column,
+            const std::string& text)
+    : first_line(first_line), first_column(first_column),
+      last_line(last_line), last_column(last_column), text(text) {}
+
+  std::size_t first_line;
+  std::size_t first_column;
+  std::size_t last_line;
+  std::size_t last_column;
+  std::string text;
+};
+
+
+/*
+ *  Prints the text of a subtree as it is in the source: each token
+ *  preceded by its white spaces.
+ */
+class source_printer: public basic_visitor {
+public:
+  source_printer(std::ostream& stream, const std::vector<std::string>& white_spaces)
+    : stream(stream), white_spaces(white_spaces) {}
+
+  virtual void visit(node& n) override {
+    accept_chain_children(n, this, true);
+  }
+
+  virtual void visit(leaf& l) override {
+    stream << white_spaces[l.get_id() - 1] << l.get_value();
+  }
+
+private:
+  std::ostream& stream;
+  const std::vector<std::string>& white_spaces;
+};
+
+
+/*
+ *  Reformats the statements overlapping the lines [first_line,
+ *  last_line], and gives the edits which change their text. A range
+ *  within the body of an IF, FOR or MACRO statement reformats only the
+ *  statements of that body, indented as the whole file reformatting
+ *  would. Each edit covers one statement and the white spaces before
+ *  it, from the end of the token before, if any.
+ *
+ *  The statements are walked from the stmt_list given to format, which
+ *  may be the one of the first statement of the range, so that the
+ *  work depends on the size of the range only.
+ */
+class range_formatter {
+public:
+  range_formatter(const std::vector<std::string>& white_spaces,
+                  std::size_t first_line, std::size_t last_line)
+    : white_spaces(white_spaces), first_line(first_line), last_line(last_line) {}
+
+  void format(node* stmt_list, const leaf* before, std::size_t indentation = 0) {
+    for (node* l(stmt_list); l;
+         l = l->get_children().size() == 2 ? static_cast<node*>(l->get_children()[1]) : nullptr) {
+      basic_node* s(l->get_children()[0]);
+      if (first_line_of(s) > last_line)
+        break;
+      if (last_line_of(s) >= first_line)
+        format_statement(static_cast<node*>(s), before, indentation);
+      before = s->get_last_leaf();
+    }
+  }
+
+  const std::vector<text_edit>& get_edits() const { return edits; }
+
+private:
+  const std::vector<std::string>& white_spaces;
+  std::size_t first_line;
+  std::size_t last_line;
+  std::vector<text_edit> edits;
+
+  static std::size_t first_line_of(const basic_node* n) {
+    return n->get_first_leaf()->get_line();
+  }
+
+  static std::size_t last_line_of(const basic_node* n) {
+    return n->get_last_leaf()->get_line();
+  }
+
+  /*
+   *  The range is within the body of a block statement when it is
+   *  after the line before the body, and before the line after it.
+   */
+  void format_statement(node* s, const leaf* before, std::size_t indentation) {
+    if (s->get_production_id() == -1)
+      return;
+
+    node* block(dynamic_cast<node*>(s->get_children()[0]));
+    std::vector<std::size_t> bodies;
+    if (block and block->get_production_id() != -1) {
+      const std::size_t size(block->get_children().size());
+      switch (block->get_symbol()) {
+      case symbol::macro_def:
+        bodies.push_back(2);
+        break;
+      case symbol::if_stmt:
+        bodies.push_back(2);
+        if (size == 6)
+          bodies.push_back(4);
+        break;
+      case symbol::for_stmt:
+        bodies.push_back(size == 9 ? 7 : 9);
+        break;
+      default:
+        break;
+      }
+    }
+
+    for (const auto b: bodies) {
+      const std::vector<basic_node*>& children(block->get_children());
+      if (first_line > last_line_of(children[b - 1])
+          and last_line < first_line_of(children[b + 1])) {
+        format(static_cast<node*>(children[b]), children[b - 1]->get_last_leaf(), indentation + 2);
+        return;
+      }
+    }
+
+    replace(s, before, indentation);
+  }
+
+  void replace(node* s, const leaf* before, std::size_t indentation) {
+    std::ostringstream text, original;
+    {
+      reformat_printer printer(text, white_spaces, indentation);
+      s->accept(&printer);
+    }
+    source_printer source(original, white_spaces);
+    s->accept(&source);
+    if (text.str() == original.str())
+      return;
+
+    std::size_t line(1), column(0);
+    if (before)
+      end_of(before, line, column);
+    std::size_t end_line, end_column;
+    end_of(s->get_last_leaf(), end_line, end_column);
+    edits.push_back(text_edit(line, column, end_line, end_column, text.str()));
+  }
+
+  static void end_of(const leaf* l, std::size_t& line, std::size_t& column) {
+    const std::string& value(l->get_value());
+    const std::string::size_type newline(value.rfind('\n'));
+    line = l->get_line() + std::count(value.begin(), value.end(), '\n');
+    column = newline == std::string::npos ? l->get_column() + value.size()
+                                          : value.size() - newline - 1;
+  }
+};
+
+#endif /* RANGE_FORMAT_H */
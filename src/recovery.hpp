@@ -0,0 +1,207 @@
+#ifndef RECOVERY_H
+#define RECOVERY_H
+
+#include <list>
+#include <vector>
+
+
+/*
+ *  The tables of the error recovery, computed once from those of the
+ *  parser and kept next to it. When the parser meets a token it cannot shift or reduce,
+ *  the goal of a state and of the terminal of the token is the
+ *  important non-terminal which, reduced right after the state, leads
+ *  to a state that accepts the token. The expected terminals of a
+ *  state are those it accepts.
+ */
+class recovery_table {
+public:
+  recovery_table(const lr_parser<symbol>& p, cf_grammar<symbol>& g)
+    : goals(p.transitions_table.size(), std::vector<short>(p.terminal_map.size(), 0)),
+      expected(p.transitions_table.size()),
+      non_terminals(p.non_terminal_map.size()) {
+    for (const auto& n: p.non_terminal_map)
+      non_terminals[n.second] = n.first;
+
+    for (std::size_t state(0); state < p.transitions_table.size(); ++state) {
+      for (const auto& t: p.terminal_map)
+        if (p.transitions_table[state][t.second])
+          expected[state].push_back(t.first);
+
+      /*
+       *  The non-terminals are visited in the order of their symbol,
+       *  so that the first goal found is the smallest one.
+       */
+      const std::vector<short>& goto_line(p.goto_table[state]);
+      for (const auto& n: p.non_terminal_map) {
+        if (not goto_line[n.second])
+          continue;
+        const symbol goal(g.get_important_goal(n.first));
+        const auto goal_id(p.non_terminal_map.find(goal));
+        if (goal_id == p.non_terminal_map.end() or not goto_line[goal_id->second])
+          continue;
+
+        const unsigned int next_state(goto_line[goal_id->second] - 1);
+        for (const auto& t: p.terminal_map)
+          if (p.transitions_table[next_state][t.second] and not goals[state][t.second])
+            goals[state][t.second] = goal_id->second + 1;
+      }
+    }
+  }
+
+  /*
+   *  The non-terminal id of the goal, plus one, or 0 if there is none.
+   */
+  short get_goal(unsigned int state, unsigned int terminal_id) const {
+    return goals[state][terminal_id];
+  }
+
+  const std::list<symbol>& get_expected(unsigned int state) const {
+    return expected[state];
+  }
+
+  symbol get_non_terminal(unsigned int id) const {
+    return non_terminals[id];
+  }
+
+private:
+  std::vector<std::vector<short> > goals;
+  std::vector<std::list<symbol> > expected;
+  std::vector<symbol> non_terminals;
+};
+
+
+/*
+ *  Deletes the nodes of a parse left on its stack, when it gives up or
+ *  when the handler or the input throws.
+ */
+class parse_stack_guard {
+public:
+  parse_stack_guard(std::vector<basic_node*>& nodes, std::vector<basic_node*>& skipped)
+    : nodes(nodes), skipped(skipped) {}
+
+  parse_stack_guard(const parse_stack_guard&) = delete;
+  parse_stack_guard& operator=(const parse_stack_guard&) = delete;
+
+  ~parse_stack_guard() {
+    for (auto n: nodes)
+      delete n;
+    for (auto n: skipped)
+      delete n;
+  }
+
+private:
+  std::vector<basic_node*>& nodes;
+  std::vector<basic_node*>& skipped;
+};
+
+
+/*
+ *  Same as parse_input_to_tree, but on a syntax error the parse goes
+ *  on, so that all the errors of a file are given to the handler in
+ *  one pass. The nodes on the top of the stack are popped down to the
+ *  first state with a goal for the unexpected token, and replaced by
+ *  a node of the goal with a production id of -1, recovered from
+ *  error, which the checkers skip. When no state has a goal, the tokens
+ *  are skipped until one has, and put in the recovered node, so that
+ *  the tree keeps all the tokens of the input. An error is given to
+ *  the handler only once three tokens were shifted since the last one,
+ *  the others usually being consequences of the recovery.
+ *
+ *  Returns nullptr when the end of the input cannot be recovered.
+ *
+ *  The parser and its recovery tables are only read, so that the
+ *  workers can share them.
+ */
+template<typename source_type, typename handler_type>
+basic_node* parse_input_with_recovery(const lr_parser<symbol>& p,
+                                      const recovery_table& recovery,
+                                      source_type& input,
+                                      tree_factory<symbol>& factory,
+                                      handler_type& handler) {
+  using token_type = token<symbol>;
+  const std::size_t quiet_shifts(3);
+
+  std::vector<unsigned int> states(1, 0);
+  std::vector<basic_node*> nodes;
+  std::vector<basic_node*> skipped;
+  std::size_t shifted(quiet_shifts);
+  std::size_t last_error(0);
+
+  const parse_stack_guard guard(nodes, skipped);
+
+  while (states.back() != p.accepting_state) {
+    const auto terminal(p.terminal_map.find(input.get().symbol));
+    const int action(terminal == p.terminal_map.end()
+                     ? 0 : p.transitions_table[states.back()][terminal->second]);
+
+    if (action > 0 and skipped.empty()) {
+      states.push_back(action - 1);
+      if (states.back() != p.accepting_state) {
+        nodes.push_back(factory.build_leaf(input));
+        input.next();
+      }
+      ++shifted;
+    } else if (action < 0 and skipped.empty()) {
+      const unsigned int rule(-action - 1);
+      const std::size_t length(p.rule_lengths[rule]);
+      basic_node* n(factory.build_node(nodes.end() - length, nodes.end(),
+                                       rule, p.reduce_symbol[rule]));
+      nodes.resize(nodes.size() - length);
+      nodes.push_back(n);
+      states.resize(states.size() - length);
+      states.push_back(p.goto_table[states.back()][p.non_terminal_map.at(p.reduce_symbol[rule])] - 1);
+    } else {
+      if (skipped.empty() and shifted >= quiet_shifts) {
+        handler(parse_error<token_type>(input.get(), recovery.get_expected(states.back())));
+      }
+      shifted = 0;
+
+      /*
+       *  The same token failing right after its recovery is skipped,
+       *  so that the parse always moves forward.
+       */
+      const bool again(skipped.empty() and last_error == input.get_lexem_id());
+      last_error = input.get_lexem_id();
+
+      /*
+       *  The recovered node takes at least one node or skipped token.
+       */
+      std::size_t depth(states.size());
+      short goal(0);
+      if (terminal != p.terminal_map.end() and not again)
+        while (not goal and depth-- > 0)
+          if (depth + 1 < states.size() or not skipped.empty())
+            goal = recovery.get_goal(states[depth], terminal->second);
+
+      if (goal) {
+        std::vector<basic_node*> children(nodes.begin() + depth, nodes.end());
+        children.insert(children.end(), skipped.begin(), skipped.end());
+        basic_node* recovered(factory.build_node(children.begin(), children.end(),
+                                                 -1, recovery.get_non_terminal(goal - 1)));
+        skipped.clear();
+        nodes.resize(depth);
+        nodes.push_back(recovered);
+        states.resize(depth + 1);
+        states.push_back(p.goto_table[states.back()][goal - 1] - 1);
+      } else if (input.get().symbol != symbol::eoi) {
+        skipped.push_back(factory.build_leaf(input));
+        input.next();
+      } else {
+        return nullptr;
+      }
+    }
+  }
+
+  /*
+   *  The accepting state is reached on the eoi token, which is not
+   *  part of the tree: the nodes left make the start production.
+   */
+  std::size_t start_rule(0);
+  while (p.reduce_symbol[start_rule] != symbol::start)
+    ++start_rule;
+  basic_node* tree(factory.build_node(nodes.begin(), nodes.end(), start_rule, symbol::start));
+  nodes.clear();
+  return tree;
+}
+
+#endif /* RECOVERY_H */
@@ -0,0 +1,350 @@
+#ifndef SERVER_H
+#define SERVER_H
+
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <csignal>
+#include <streambuf>
+#include <iostream>
+#include <exception>
+#include <system_error>
+#include <thread>
+#include <mutex>
+#include <atomic>
+
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <sys/un.h>
+
+
+/*
+ *  Resident server protocol, over a Unix domain socket.
+ *
+ *  The client sends a request made of a count followed by that many
+ *  strings, each prefixed by its length: the working directory, the
+ *  values of the ALUCELL_*_MACRO_DIR environment variables (as
+ *  "NAME=value", or "NAME" when unset), "1" when the standard output
+ *  of the client is a terminal or "0", then the command line
+ *  arguments. The server answers with a sequence of frames: 'o'
+ *  followed by a length and a chunk of output, and finally 'x'
+ *  followed by the exit status.
+ *
+ *  A request has at most max_request_strings strings and
+ *  max_request_size bytes, and has to be received within
+ *  request_timeout_seconds, otherwise the connection is closed.
+ */
+
+const std::uint32_t max_request_strings(65536);
+const std::uint32_t max_request_size(64 << 20);
+const int request_timeout_seconds(10);
+const unsigned int max_connections(64);
+
+inline
+std::string default_socket_path() {
+  const char* runtime_dir(std::getenv("XDG_RUNTIME_DIR"));
+  if (runtime_dir)
+    return std::string(runtime_dir) + "/alint.sock";
+  return "/tmp/alint-" + std::to_string(getuid()) + ".sock";
+}
+
+inline
+bool write_all(int fd, const char* data, std::size_t size) {
+  while (size) {
+    const ssize_t n(write(fd, data, size));
+    if (n <= 0)
+      return false;
+    data += n;
+    size -= n;
+  }
+  return true;
+}
+
+inline
+bool read_all(int fd, char* data, std::size_t size) {
+  while (size) {
+    const ssize_t n(read(fd, data, size));
+    if (n <= 0)
+      return false;
+    data += n;
+    size -= n;
+  }
+  return true;
+}
+
+inline
+bool write_frame_header(int fd, char type, std::uint32_t value) {
+  char header[1 + sizeof(std::uint32_t)];
+  header[0] = type;
+  std::memcpy(header + 1, &value, sizeof(value));
+  return write_all(fd, header, sizeof(header));
+}
+
+inline
+bool write_strings(int fd, const std::vector<std::string>& strings) {
+  std::string message;
+  const std::uint32_t count(strings.size());
+  message.append(reinterpret_cast<const char*>(&count), sizeof(count));
+  for (const auto& s: strings) {
+    const std::uint32_t size(s.size());
+    message.append(reinterpret_cast<const char*>(&size), sizeof(size));
+    message.append(s);
+  }
+  return write_all(fd, message.data(), message.size());
+}
+
+/*
+ *  Read a count and that many strings, which may not exceed
+ *  max_count strings and max_size bytes in all.
+ */
+inline
+bool read_strings(int fd, std::vector<std::string>& strings,
+                  std::uint32_t max_count, std::uint32_t max_size) {
+  std::uint32_t count;
+  if (not read_all(fd, reinterpret_cast<char*>(&count), sizeof(count)) or count > max_count)
+    return false;
+
+  strings.clear();
+  std::uint32_t total(0);
+  for (std::uint32_t i(0); i < count; ++i) {
+    std::uint32_t size;
+    if (not read_all(fd, reinterpret_cast<char*>(&size), sizeof(size))
+        or size > max_size - total)
+      return false;
+    total += size;
+    std::string s(size, '\0');
+    if (size and not read_all(fd, &s[0], size))
+      return false;
+    strings.push_back(s);
+  }
+  return true;
+}
+
+inline
+sockaddr_un make_socket_address(const std::string& path) {
+  sockaddr_un address;
+  std::memset(&address, 0, sizeof(address));
+  address.sun_family = AF_UNIX;
+  if (path.size() >= sizeof(address.sun_path))
+    throw std::string("error: socket path too long: ") + path;
+  std::strcpy(address.sun_path, path.c_str());
+  return address;
+}
+
+
+/*
+ *  Output buffer sending its content to the client as 'o' frames.
+ */
+class socket_streambuf: public std::streambuf {
+public:
+  socket_streambuf(int fd): fd(fd), failed(false) {
+    setp(buffer, buffer + sizeof(buffer));
+  }
+
+  virtual ~socket_streambuf() {
+    sync();
+  }
+
+protected:
+  virtual int_type overflow(int_type c) override {
+    if (flush() != 0)
+      return traits_type::eof();
+    if (not traits_type::eq_int_type(c, traits_type::eof())) {
+      *pptr() = traits_type::to_char_type(c);
+      pbump(1);
+    }
+    return traits_type::not_eof(c);
+  }
+
+  virtual int sync() override {
+    return flush();
+  }
+
+private:
+  int fd;
+  bool failed;
+  char buffer[65536];
+
+  int flush() {
+    const std::size_t size(pptr() - pbase());
+    if (size and not failed)
+      failed = not (write_frame_header(fd, 'o', size)
+                    and write_all(fd, pbase(), size));
+    setp(buffer, buffer + sizeof(buffer));
+    return failed ? -1 : 0;
+  }
+};
+
+
+/*
+ *  Send the command line to the server, copy its output to the
+ *  standard output, and return its exit status.
+ */
+inline
+int run_client(const std::string& socket_path,
+               const std::vector<std::string>& arguments) {
+  const int fd(socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0));
+  if (fd < 0)
+    throw std::string("error: could not create a socket.");
+
+  const sockaddr_un address(make_socket_address(socket_path));
+  if (connect(fd, reinterpret_cast<const sockaddr*>(&address), sizeof(address)) != 0) {
+    close(fd);
+    throw std::string("error: could not connect to the server at ") + socket_path;
+  }
+
+  std::vector<std::string> request;
+  char* cwd(getcwd(nullptr, 0));
+  request.push_back(cwd ? cwd : ".");
+  std::free(cwd);
+
+  for (const char* name: {"ALUCELL_GLOBAL_MACRO_DIR", "ALUCELL_LOCAL_MACRO_DIR"}) {
+    const char* value(std::getenv(name));
+    request.push_back(value ? std::string(name) + "=" + value : std::string(name));
+  }
+  request.push_back(isatty(1) ? "1" : "0");
+  request.insert(request.end(), arguments.begin(), arguments.end());
+
+  if (not write_strings(fd, request)) {
+    close(fd);
+    throw std::string("error: could not send the request to the server.");
+  }
+
+  std::vector<char> chunk;
+  while (true) {
+    char type;
+    std::uint32_t value;
+    if (not read_all(fd, &type, 1)
+        or not read_all(fd, reinterpret_cast<char*>(&value), sizeof(value)))
+      break;
+
+    if (type == 'x') {
+      close(fd);
+      return value;
+    }
+
+    chunk.resize(value);
+    if (value and not read_all(fd, chunk.data(), value))
+      break;
+    write_all(1, chunk.data(), value);
+  }
+
+  close(fd);
+  throw std::string("error: connection to the server lost.");
+}
+
+
+/*
+ *  Read the request of a client and answer it, once the requests of
+ *  the other clients are done.
+ */
+template<typename handler_type>
+void serve_connection(int fd, handler_type& handler, std::mutex& requests_lock) {
+  try {
+    std::vector<std::string> request;
+    if (read_strings(fd, request, max_request_strings, max_request_size) and request.size() >= 4) {
+      std::lock_guard<std::mutex> lock(requests_lock);
+      for (std::size_t i(1); i < 3; ++i) {
+        const std::string::size_type equal_position(request[i].find('='));
+        if (equal_position == std::string::npos)
+          unsetenv(request[i].c_str());
+        else
+          setenv(request[i].substr(0, equal_position).c_str(),
+                 request[i].substr(equal_position + 1).c_str(), 1);
+      }
+
+      int status(1);
+      {
+        socket_streambuf output(fd);
+        std::streambuf* previous(std::cout.rdbuf(&output));
+        try {
+          if (chdir(request[0].c_str()) == 0)
+            status = handler(std::vector<std::string>(request.begin() + 4, request.end()),
+                             request[3] == "1");
+          else
+            std::cout << "error: could not change directory to " << request[0] << std::endl;
+        }
+        catch (const std::exception& e) {
+          std::cout << "error: " << e.what() << std::endl;
+        }
+        catch (...) {
+          std::cout << "error: the request failed." << std::endl;
+        }
+        std::cout.flush();
+        std::cout.rdbuf(previous);
+      }
+
+      write_frame_header(fd, 'x', status);
+    }
+  }
+  catch (...) {
+  }
+  close(fd);
+}
+
+
+/*
+ *  Accept the client connections, each one on its own thread, so that
+ *  a client slow to send its request does not hold the others. The
+ *  requests themselves are handled one at a time: for each one, the
+ *  working directory and the environment of the client are restored,
+ *  the standard output is redirected to the client, and
+ *  handler(arguments, terminal) is called, with whether the output of
+ *  the client is a terminal, which returns the exit status. An
+ *  exception thrown by handler fails the request with the status 1,
+ *  the server goes on with the next one.
+ */
+template<typename handler_type>
+void serve(const std::string& socket_path, handler_type handler) {
+  std::signal(SIGPIPE, SIG_IGN);
+
+  const int listen_fd(socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0));
+  if (listen_fd < 0)
+    throw std::string("error: could not create a socket.");
+
+  unlink(socket_path.c_str());
+  const sockaddr_un address(make_socket_address(socket_path));
+  const mode_t mask(umask(077));
+  const bool bound(bind(listen_fd, reinterpret_cast<const sockaddr*>(&address),
+                        sizeof(address)) == 0);
+  umask(mask);
+  if (not bound or listen(listen_fd, SOMAXCONN) != 0) {
+    close(listen_fd);
+    throw std::string("error: could not listen on ") + socket_path;
+  }
+
+  std::cout << "listening on " << socket_path << std::endl;
+
+  std::mutex requests_lock;
+  std::atomic<unsigned int> connections(0);
+  while (true) {
+    const int fd(accept4(listen_fd, nullptr, nullptr, SOCK_CLOEXEC));
+    if (fd < 0)
+      continue;
+
+    timeval timeout{request_timeout_seconds, 0};
+    if (connections >= max_connections
+        or setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout)) != 0) {
+      close(fd);
+      continue;
+    }
+
+    ++connections;
+    try {
+      std::thread([fd, &handler, &requests_lock, &connections]() {
+          serve_connection(fd, handler, requests_lock);
+          --connections;
+        }).detach();
+    }
+    catch (const std::system_error&) {
+      --connections;
+      close(fd);
+    }
+  }
+}
+
+#endif /* SERVER_H */
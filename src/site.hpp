@@ -0,0 +1,288 @@
+#ifndef SITE_H
+#define SITE_H
+
+#include <map>
+#include <set>
+#include <stack>
+#include <string>
+#include <vector>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+#include <cstdint>
+#include <cctype>
+
+#include "file_utils.hpp"
+#include "dependency_graph.hpp"
+
+
+/*
+ *  Static html site of a macro tree: one page per file, where the
+ *  @input file names and the macro names link to the page of the file
+ *  they refer to, followed by the list of the files which refer to it.
+ *
+ *  The pages mirror the canonical paths of the files under the site
+ *  directory. A page depends on the content of its file, on which of
+ *  its references have a page, and on the files which refer to it.
+ *  The fingerprint of those is kept in the manifest of the site, so
+ *  that a page is only rendered again when its fingerprint changes.
+ */
+
+inline
+std::string site_page_name(const std::string& file) {
+  return (file.size() and file[0] == '/' ? file.substr(1) : file) + ".html";
+}
+
+/*
+ *  Relative href from a page to another one, both given by their path
+ *  in the site directory.
+ */
+inline
+std::string site_href(const std::string& from_page, const std::string& to_page) {
+  static const char* hex("0123456789ABCDEF");
+  std::string href;
+  for (const char c: from_page)
+    if (c == '/')
+      href += "../";
+
+  for (const char c: to_page) {
+    const unsigned char u(c);
+    if (std::isalnum(u) or c == '/' or c == '-' or c == '_' or c == '.' or c == '~')
+      href += c;
+    else {
+      href += '%';
+      href += hex[u >> 4];
+      href += hex[u & 0xf];
+    }
+  }
+  return href;
+}
+
+
+/*
+ *  The existing files of the tree of the roots, by canonical path.
+ */
+inline
+std::set<std::string> site_files(const dependency_graph& graph,
+                                  const std::vector<std::string>& roots) {
+  std::set<std::string> files;
+  std::set<std::string> visited;
+  std::stack<std::string> unvisited;
+  for (const auto& r: roots)
+    unvisited.push(canonical_path(r));
+
+  while (unvisited.size()) {
+    const std::string f(unvisited.top());
+    unvisited.pop();
+    if (not visited.insert(f).second)
+      continue;
+
+    const auto record(graph.get_files().find(f));
+    if (record == graph.get_files().end() or record->second.mtime == 0)
+      continue;
+
+    files.insert(f);
+    for (const auto& d: record->second.dependencies)
+      unvisited.push(d.first);
+  }
+  return files;
+}
+
+
+/*
+ *  The files of the site which refer to a file, and how.
+ */
+inline
+std::vector<std::pair<std::string, dependency_kind> >
+site_references(const std::string& file, const dependency_graph& graph,
+                const std::set<std::string>& files) {
+  std::vector<std::pair<std::string, dependency_kind> > references;
+  for (const auto& d: graph.get_dependents(file)) {
+    if (not files.count(d))
+      continue;
+    const dependency_list& dependencies(graph.get_dependencies(d));
+    const auto item(dependencies.find(file));
+    if (item != dependencies.end())
+      references.push_back(std::make_pair(d, item->second));
+  }
+  return references;
+}
+
+
+/*
+ *  64 bits FNV-1a hash of what a page depends on.
+ */
+inline
+std::uint64_t site_page_fingerprint(const std::string& file, const dependency_graph& graph,
+                                    const std::set<std::string>& files) {
+  std::ostringstream inputs;
+  inputs << "alint site 1\n" << graph.get_files().find(file)->second.hash << '\n';
+  for (const auto& d: graph.get_dependencies(file))
+    inputs << "dep\t" << d.second << '\t' << d.first << '\t' << files.count(d.first) << '\n';
+  for (const auto& r: site_references(file, graph, files))
+    inputs << "ref\t" << r.second << '\t' << r.first << '\n';
+
+  std::uint64_t hash(14695981039346656037ull);
+  for (const char c: inputs.str()) {
+    hash ^= static_cast<unsigned char>(c);
+    hash *= 1099511628211ull;
+  }
+  return hash;
+}
+
+
+/*
+ *  Links of the references of a page to the pages of the site, as the
+ *  dependency_extractor resolves them.
+ */
+class site_links: public html_links {
+public:
+  site_links(const options& opt, const std::string& page, const std::set<std::string>& files)
+    : global_macro_dir(opt.global_macro_dir), local_macro_dir(opt.local_macro_dir),
+      page(page), files(files) {}
+
+  virtual std::string get_href(dependency_kind kind, const std::string& name) const override {
+    std::string file(name);
+    if (kind == dependency_kind::global_macro)
+      file = global_macro_dir + name;
+    else if (kind == dependency_kind::local_macro)
+      file = local_macro_dir + name;
+
+    file = canonical_path(file);
+    return files.count(file) ? site_href(page, site_page_name(file)) : std::string();
+  }
+
+private:
+  std::string global_macro_dir;
+  std::string local_macro_dir;
+  std::string page;
+  const std::set<std::string>& files;
+};
+
+
+/*
+ *  The html page of a file, around its highlighted code.
+ */
+inline
+std::string site_page(const std::string& file, const std::string& code,
+                      const std::vector<std::pair<std::string, dependency_kind> >& references) {
+  const std::string page(site_page_name(file));
+  std::ostringstream html;
+  html << "<!DOCTYPE html>\n<html>\n<head>\n<meta charset=\"utf-8\">\n"
+       << "<title>" << html_escape(file) << "</title>\n"
+       << "<link rel=\"stylesheet\" href=\"" << site_href(page, "alint.css") << "\">\n"
+       << "</head>\n<body>\n"
+       << "<p><a href=\"" << site_href(page, "index.html") << "\">index</a></p>\n"
+       << "<h1>" << html_escape(file) << "</h1>\n"
+       << "<pre><code>" << code << "</code></pre>\n"
+       << "<h2>Referenced by</h2>\n";
+
+  if (references.empty())
+    html << "<p>No file of the site refers to this one.</p>\n";
+  else {
+    html << "<ul>\n";
+    for (const auto& r: references)
+      html << "<li><a href=\"" << site_href(page, site_page_name(r.first)) << "\">"
+           << html_escape(r.first) << "</a> (" << r.second << ")</li>\n";
+    html << "</ul>\n";
+  }
+
+  html << "</body>\n</html>\n";
+  return html.str();
+}
+
+
+inline
+std::string site_index(const std::set<std::string>& files) {
+  std::ostringstream html;
+  html << "<!DOCTYPE html>\n<html>\n<head>\n<meta charset=\"utf-8\">\n"
+       << "<title>alint</title>\n"
+       << "<link rel=\"stylesheet\" href=\"alint.css\">\n"
+       << "</head>\n<body>\n<h1>Macro files</h1>\n<ul>\n";
+  for (const auto& f: files)
+    html << "<li><a href=\"" << site_href("", site_page_name(f)) << "\">"
+         << html_escape(f) << "</a></li>\n";
+  html << "</ul>\n</body>\n</html>\n";
+  return html.str();
+}
+
+
+inline
+const char* site_stylesheet() {
+  return
+    "pre { line-height: 1.3; }\n"
+    ".alucell-keyword { color: #0000c0; font-weight: bold; }\n"
+    ".alucell-macro { color: #800080; }\n"
+    ".alucell-comment { color: #008000; }\n"
+    ".alucell-visual-comment { color: #008000; font-weight: bold; }\n"
+    ".alucell-shell-escape { color: #c06000; }\n"
+    ".alucell-number { color: #c00000; }\n"
+    ".alucell-string { color: #a05000; }\n";
+}
+
+
+/*
+ *  The fingerprint of each page of a site, when it was last rendered.
+ */
+class site_manifest {
+public:
+  void load(const std::string& filename) {
+    std::ifstream file(filename.c_str(), std::ios::in);
+    if (not file)
+      return;
+
+    std::string line;
+    std::getline(file, line);
+    if (line != header())
+      throw std::string("error: ") + filename + " is not an alint site manifest.";
+
+    while (std::getline(file, line)) {
+      std::istringstream fields(line);
+      std::string type, name, fingerprint;
+      std::getline(fields, type, '\t');
+      std::getline(fields, name, '\t');
+      std::getline(fields, fingerprint, '\t');
+      if (type != "page" or fingerprint.empty())
+        throw std::string("error: ") + filename + ": malformed site manifest.";
+      try {
+        pages[name] = std::stoull(fingerprint);
+      }
+      catch (const std::logic_error&) {
+        throw std::string("error: ") + filename + ": malformed site manifest.";
+      }
+    }
+  }
+
+  void save(const std::string& filename) const {
+    std::ostringstream content;
+    content << header() << '\n';
+    for (const auto& p: pages)
+      content << "page\t" << p.first << '\t' << p.second << '\n';
+    write_file_atomically(filename, content.str());
+  }
+
+  /*
+   *  0 when the page has never been rendered.
+   */
+  std::uint64_t get_fingerprint(const std::string& file) const {
+    const auto item(pages.find(file));
+    return item == pages.end() ? 0 : item->second;
+  }
+
+  void set_fingerprint(const std::string& file, std::uint64_t fingerprint) {
+    pages[file] = fingerprint;
+  }
+
+  void remove(const std::string& file) {
+    pages.erase(file);
+  }
+
+  const std::map<std::string, std::uint64_t>& get_pages() const { return pages; }
+
+private:
+  static const char* header() { return "alint site manifest 1"; }
+
+  std::map<std::string, std::uint64_t> pages;
+};
+
+#endif /* SITE_H */
@@ -0,0 +1,278 @@
+#ifndef STATS_H
+#define STATS_H
+
+#include <string>
+#include <vector>
+#include <utility>
+#include <ostream>
+#include <sstream>
+#include <iomanip>
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+
+#include "file_utils.hpp"
+#include "trace.hpp"
+#include "allocations.hpp"
+
+
+struct phase_statistics {
+  phase_statistics(const std::string& name)
+    : name(name), time(0.0), allocations(0), allocated_bytes(0) {}
+
+  std::string name;
+  double time;
+  std::uint64_t allocations;
+  std::uint64_t allocated_bytes;
+};
+
+
+/*
+ *  Time and allocations of each phase of the analysis of a file, in
+ *  the order the phases were first entered, with the size of the
+ *  input and of its syntax tree.
+ */
+struct file_statistics {
+  file_statistics(const std::string& filename = "")
+    : filename(filename), bytes(0), tokens(0), nodes(0), leafs(0),
+      live_bytes(0), peak_bytes(0) {}
+
+  void add(const phase_statistics& phase) {
+    for (auto& p: phases)
+      if (p.name == phase.name) {
+        p.time += phase.time;
+        p.allocations += phase.allocations;
+        p.allocated_bytes += phase.allocated_bytes;
+        return;
+      }
+    phases.push_back(phase);
+  }
+
+  double total_time() const {
+    double total(0.0);
+    for (const auto& p: phases)
+      total += p.time;
+    return total;
+  }
+
+  void merge(const file_statistics& other) {
+    bytes += other.bytes;
+    tokens += other.tokens;
+    nodes += other.nodes;
+    leafs += other.leafs;
+    peak_bytes = std::max(peak_bytes, other.peak_bytes);
+    for (const auto& p: other.phases)
+      add(p);
+  }
+
+  std::string filename;
+  std::uint64_t bytes;
+  std::size_t tokens;
+  std::size_t nodes;
+  std::size_t leafs;
+  std::vector<phase_statistics> phases;
+
+  /*
+   *  The heap in use when the file was opened, and the most used
+   *  above it until the file was closed.
+   */
+  std::int64_t live_bytes;
+  std::int64_t peak_bytes;
+};
+
+
+class tree_size_counter: public basic_visitor {
+public:
+  tree_size_counter(): nodes(0), leafs(0) {}
+
+  virtual void visit(node& n) {
+    for (node* c(&n); c; ) {
+      node* next(c->get_chain_next());
+      ++nodes;
+      for (auto child: c->get_children())
+        if (child != next)
+          child->accept(this);
+      c = next;
+    }
+  }
+
+  virtual void visit(leaf&) {
+    ++leafs;
+  }
+
+  std::size_t nodes;
+  std::size_t leafs;
+};
+
+
+/*
+ *  Statistics of a run, enabled by --stats. The files are opened by
+ *  begin_file and closed by end_file, which prints their line; a file
+ *  analysed while another one is open, as with -r, gets its own
+ *  record. The phases are always added to the innermost open file.
+ *
+ *  With --allocations, the heap allocations are counted as well: per
+ *  phase, and the high-water mark of the heap per file.
+ *
+ *  Only the totals and the slowest files are kept, so that the memory
+ *  does not grow with the number of files.
+ */
+class statistics {
+public:
+  statistics()
+    : enabled(false), allocations(false), setup_time(0.0), files(0), slowest_count(10) {}
+
+  void set_enabled(bool e) { enabled = e; }
+  bool is_enabled() const { return enabled; }
+
+  void set_allocations(bool a) {
+    allocations = a;
+    global_allocations().enabled = a;
+  }
+  bool counts_allocations() const { return allocations; }
+
+  void set_setup_time(double seconds) { setup_time = seconds; }
+
+  void begin_file(const std::string& filename) {
+    if (not enabled)
+      return;
+    const std::int64_t peak(global_allocations().peak);
+    if (not open.empty())
+      open.back().peak_bytes = std::max(open.back().peak_bytes, peak - open.back().live_bytes);
+
+    open.push_back(file_statistics(filename));
+    open.back().bytes = get_file_size(filename);
+    open.back().live_bytes = global_allocations().live;
+    global_allocations().peak = open.back().live_bytes;
+  }
+
+  void add(const phase_statistics& phase) {
+    if (enabled and not open.empty())
+      open.back().add(phase);
+  }
+
+  void set_tokens(std::size_t tokens) {
+    if (enabled and not open.empty())
+      open.back().tokens = tokens;
+  }
+
+  void count_tree(basic_node* tree) {
+    if (not enabled or open.empty() or not tree)
+      return;
+    tree_size_counter counter;
+    tree->accept(&counter);
+    open.back().nodes = counter.nodes;
+    open.back().leafs = counter.leafs;
+  }
+
+  void end_file(std::ostream& stream) {
+    if (not enabled or open.empty())
+      return;
+    file_statistics f(open.back());
+    open.pop_back();
+    const std::int64_t peak(global_allocations().peak);
+    f.peak_bytes = std::max(f.peak_bytes, peak - f.live_bytes);
+    if (not open.empty())
+      open.back().peak_bytes = std::max(open.back().peak_bytes, peak - open.back().live_bytes);
+
+    stream << "stats: ";
+    print(stream, f);
+    stream << std::endl;
+
+    ++files;
+    total.merge(f);
+    slowest.push_back(f);
+    std::sort(slowest.begin(), slowest.end(), [](const file_statistics& a, const file_statistics& b) {
+        return a.total_time() > b.total_time();
+      });
+    if (slowest.size() > slowest_count)
+      slowest.pop_back();
+  }
+
+  void print_summary(std::ostream& stream) const {
+    if (not enabled)
+      return;
+    stream << "stats: grammar and tables: " << milliseconds(setup_time) << std::endl
+           << "stats: total of " << files << " files: ";
+    print(stream, total);
+    stream << std::endl;
+
+    if (slowest.empty())
+      return;
+    stream << "stats: slowest files:" << std::endl;
+    for (const auto& f: slowest)
+      stream << "stats: " << std::setw(12) << milliseconds(f.total_time())
+             << std::setw(12) << f.bytes << "B  " << f.filename << std::endl;
+  }
+
+private:
+  static std::string milliseconds(double seconds) {
+    std::ostringstream s;
+    s << std::fixed << std::setprecision(3) << seconds * 1e3 << "ms";
+    return s.str();
+  }
+
+  void print(std::ostream& stream, const file_statistics& f) const {
+    const double time(f.total_time());
+    if (not f.filename.empty())
+      stream << f.filename << ": ";
+    stream << f.bytes << " bytes, " << f.tokens << " tokens, "
+           << f.nodes << " nodes, " << f.leafs << " leafs";
+    for (const auto& p: f.phases) {
+      stream << ", " << p.name << " " << milliseconds(p.time);
+      if (allocations)
+        stream << " " << p.allocations << " allocs " << p.allocated_bytes << "B";
+    }
+    if (allocations)
+      stream << ", peak " << f.peak_bytes << "B";
+    if (time > 0.0)
+      stream << ", " << std::fixed << std::setprecision(2)
+             << f.bytes / time / 1e6 << " MB/s, "
+             << f.tokens / time / 1e6 << " Mtokens/s"
+             << std::defaultfloat;
+  }
+
+  bool enabled;
+  bool allocations;
+  double setup_time;
+  std::size_t files;
+  std::size_t slowest_count;
+  file_statistics total;
+  std::vector<file_statistics> open;
+  std::vector<file_statistics> slowest;
+};
+
+
+inline
+statistics& default_statistics() {
+  static statistics s;
+  return s;
+}
+
+
+/*
+ *  Adds the time spent and the allocations made in its scope to a
+ *  phase of the current file, and traces it.
+ */
+class phase_timer {
+public:
+  using clock = std::chrono::steady_clock;
+
+  phase_timer(const std::string& phase): phase(phase), span(phase), start(clock::now()) {}
+
+  ~phase_timer() {
+    const allocation_snapshot end;
+    phase.time = std::chrono::duration<double>(clock::now() - start).count();
+    phase.allocations = end.count - allocated.count;
+    phase.allocated_bytes = end.bytes - allocated.bytes;
+    default_statistics().add(phase);
+  }
+
+private:
+  phase_statistics phase;
+  trace_span span;
+  allocation_snapshot allocated;
+  clock::time_point start;
+};
+
+#endif /* STATS_H */
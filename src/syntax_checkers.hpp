@@ -3,12 +3,17 @@
 
 #include <string>
 #include <cstddef>
+#include <vector>
+#include <algorithm>
 #include <fstream>
+#include <map>
+#include <set>
 
 #include <spikes/string_builder.hpp>
 
 #include "options.hpp"
 #include "file_utils.hpp"
+#include "diagnostics.hpp"
 
 
 /*
@@ -28,19 +33,12 @@
  */
 
 
-void print_warning(const source_coordinate_range* coord, const std::string& msg) {
+void print_warning(const leaf* l, const std::string& rule, const std::string& msg) {
   using coord_t = file_source_coordinate_range;
 
-  const coord_t* c(dynamic_cast<const coord_t*>(coord));
-
-  std::cout << c->render() << " ";
-  if (isatty(1))
-    std::cout << ansi::bold << ansi::color(208) << "warning" << ansi::normal;
-  else
-    std::cout << "warning";
-
-  std::cout << ": " << msg << std::endl;
-  show_coordinates_in_file(c->get_filename(), c->get_line(), c->get_column());
+  const coord_t* c(dynamic_cast<const coord_t*>(l->get_lexem_coordinates()));
+  report_diagnostic(diagnostic(c->get_filename(), l->get_line(), l->get_column(), "warning", msg, rule,
+                               l->get_line() == c->get_line() ? c->render() : std::string()));
 }
 
 
@@ -87,9 +85,7 @@ public:
       break;
 
     case symbol::stmt_list:
-      n.get_children()[0]->accept(this);
-      if (n.get_children().size() == 2)
-        n.get_children()[1]->accept(this);
+      accept_chain_children(n, this);
       break;
 
     default:
@@ -103,7 +99,7 @@ public:
     } else if (l.get_symbol() == symbol::enddo_kw) {
       const std::string enddo_guard_value(l.get_value().substr(7, l.get_value().size() - 7 - 2));
       if (enddo_guard_value != do_guard_value)
-        print_warning(l.get_lexem_coordinates(),
+        print_warning(&l, "do-enddo-guard",
                       string_builder("DO \"")(do_guard_value)("\" doesn't match ENDDO \"")
                                     (enddo_guard_value)("\" guard value.").str());
 
@@ -112,7 +108,7 @@ public:
         inline_macro_name.push_back(l.get_value());
       } else {
         if (inline_macro_name.back() != l.get_value())
-          print_warning(l.get_lexem_coordinates(),
+          print_warning(&l, "macro-guard",
                         string_builder("MACRO \"")(inline_macro_name.back())("\" don't match ENDMACRO \"")
                                       (l.get_value())("\" guard value.").str());
         inline_macro_name.clear();
@@ -169,6 +165,24 @@ std::string get_input_filename(basic_node* tree) {
 }
 
 
+enum class dependency_kind {
+  input, local_macro, global_macro
+};
+
+
+std::ostream& operator<<(std::ostream& stream, dependency_kind k) {
+  switch (k) {
+  case dependency_kind::input: stream << "input"; break;
+  case dependency_kind::local_macro: stream << "local_macro"; break;
+  case dependency_kind::global_macro: stream << "global_macro"; break;
+  }
+  return stream;
+}
+
+
+using dependency_list = std::map<std::string, dependency_kind>;
+
+
 class dependency_extractor: public basic_visitor {
 public:
   dependency_extractor(const options& opt):
@@ -189,9 +203,7 @@ public:
       break;
 
     case symbol::stmt_list:
-      n.get_children()[0]->accept(this);
-      if (n.get_children().size() == 2)
-        n.get_children()[1]->accept(this);
+      accept_chain_children(n, this);
       break;
 
 
@@ -221,8 +233,11 @@ public:
       n.get_children()[0]->accept(this);
       break;
 
-    case symbol::input:
-      filenames.insert(get_input_filename(&n));
+    case symbol::input: {
+      const std::string filename(get_input_filename(&n));
+      filenames.insert(filename);
+      dependencies.insert(std::make_pair(filename, dependency_kind::input));
+    }
       break;
 
     default:
@@ -236,9 +251,13 @@ public:
       break;
     case symbol::global_macro_name:
       filenames.insert(global_macro_dir + l.get_value());
+      dependencies.insert(std::make_pair(global_macro_dir + l.get_value(),
+                                         dependency_kind::global_macro));
       break;
     case symbol::local_macro_name:
       filenames.insert(local_macro_dir + l.get_value());
+      dependencies.insert(std::make_pair(local_macro_dir + l.get_value(),
+                                         dependency_kind::local_macro));
       break;
 
     default:
@@ -247,14 +266,16 @@ public:
   }
 
   const std::set<std::string>& get_filenames() const { return filenames; }
+  const dependency_list& get_dependencies() const { return dependencies; }
 
-  void clear() { filenames.clear(); }
+  void clear() { filenames.clear(); dependencies.clear(); }
 
 private:
   std::string global_macro_dir;
   std::string local_macro_dir;
 
   std::set<std::string> filenames;
+  dependency_list dependencies;
 };
 
 std::set<std::string> show_input_and_macro_dependencies(basic_node* tree, const options& opt) {
@@ -263,6 +284,12 @@ std::set<std::string> show_input_and_macro_dependencies(basic_node* tree, const
   return extractor.get_filenames();
 }
 
+dependency_list extract_dependencies(basic_node* tree, const options& opt) {
+  dependency_extractor extractor(opt);
+  tree->accept(&extractor);
+  return extractor.get_dependencies();
+}
+
 class white_spaces_checker: public basic_visitor {
 public:
   using coord_t = file_source_coordinate_range;
@@ -280,9 +307,7 @@ public:
       break;
 
     case symbol::stmt_list:
-      n.get_children()[0]->accept(this);
-      if (n.get_children().size() == 2)
-        n.get_children()[1]->accept(this);
+      accept_chain_children(n, this);
       break;
 
     case symbol::for_stmt:
@@ -290,25 +315,25 @@ public:
          // initial condition
         if (not check_white_spaces_in_range(n.get_children()[1]->get_first_lexem_id(),
                                             n.get_children()[3]->get_last_lexem_id()))
-          print_warning(n.get_children()[1]->get_first_lexem_coordinates(),
+          print_warning(n.get_children()[1]->get_first_leaf(), "for-header-white-spaces",
                         string_builder("white spaces in the initialisation of the for statement.").str());
 
          // upper boundary
         if (not check_white_spaces_in_range(n.get_children()[5]->get_first_lexem_id(),
                                             n.get_children()[5]->get_last_lexem_id()))
-          print_warning(n.get_children()[5]->get_first_lexem_coordinates(),
+          print_warning(n.get_children()[5]->get_first_leaf(), "for-header-white-spaces",
                         string_builder("white spaces in the stop condition of the for statement.").str());
 
 
 	// do
 	if (not is_on_new_line(ws[n.get_children()[7]->get_first_lexem_id() - 1])
 	    and n.get_children()[7]->get_first_leaf()->get_symbol() != symbol::comment)
-          print_warning(n.get_children()[7]->get_first_lexem_coordinates(),
+          print_warning(n.get_children()[7]->get_first_leaf(), "statement-on-new-line",
                         string_builder("expression following the DO keyword is not on a new line.").str());
 
 	// enddo
 	if (not is_on_new_line(ws[n.get_children()[8]->get_first_lexem_id()]))
-          print_warning(n.get_children()[8]->get_first_lexem_coordinates(),
+          print_warning(n.get_children()[8]->get_first_leaf(), "statement-on-new-line",
                         string_builder("expression following the ENDDO keyword is not on a new line.").str());
 
         n.get_children()[7]->accept(this); // symbol::stmt_list
@@ -316,33 +341,33 @@ public:
         // initial condition
         if (not check_white_spaces_in_range(n.get_children()[1]->get_first_lexem_id(),
                                             n.get_children()[3]->get_last_lexem_id()))
-          print_warning(n.get_children()[1]->get_first_lexem_coordinates(),
+          print_warning(n.get_children()[1]->get_first_leaf(), "for-header-white-spaces",
                         string_builder("white spaces in the initialisation of the for statement.").str());
 
 
          // upper boundary
         if (not check_white_spaces_in_range(n.get_children()[5]->get_first_lexem_id(),
                                             n.get_children()[5]->get_last_lexem_id()))
-          print_warning(n.get_children()[5]->get_first_lexem_coordinates(),
+          print_warning(n.get_children()[5]->get_first_leaf(), "for-header-white-spaces",
                         string_builder("white spaces in the stop condition of the for statement.").str());
 
 
          // step
         if (not check_white_spaces_in_range(n.get_children()[7]->get_first_lexem_id(),
                                             n.get_children()[7]->get_last_lexem_id()))
-          print_warning(n.get_children()[7]->get_first_lexem_coordinates(),
+          print_warning(n.get_children()[7]->get_first_leaf(), "for-header-white-spaces",
                         string_builder("white spaces in the step condition of the for statement.").str());
 
 	// do
 	if (not is_on_new_line(ws[n.get_children()[8]->get_first_lexem_id()])
 	    and n.get_children()[9]->get_first_leaf()->get_symbol() != symbol::comment)
-          print_warning(n.get_children()[9]->get_first_lexem_coordinates(),
+          print_warning(n.get_children()[9]->get_first_leaf(), "statement-on-new-line",
                         string_builder("expression following the DO keyword is not on a new line.").str());
 
 
 	// enddo
 	if (not is_on_new_line(ws[n.get_children()[10]->get_first_lexem_id()]))
-          print_warning(n.get_children()[10]->get_first_lexem_coordinates(),
+          print_warning(n.get_children()[10]->get_first_leaf(), "statement-on-new-line",
                         string_builder("expression following the ENDDO keyword is not on a new line.").str());
 
 
@@ -357,22 +382,22 @@ public:
     case symbol::if_stmt: {
       if (not is_on_new_line(ws[n.get_children()[2]->get_first_lexem_id() - 1])
 	  and n.get_children()[2]->get_first_leaf()->get_symbol() != symbol::comment)
-        print_warning(n.get_children()[2]->get_first_lexem_coordinates(),
+        print_warning(n.get_children()[2]->get_first_leaf(), "statement-on-new-line",
                         string_builder("expression following the THEN keyword is not on a new line.").str());
 
       if (n.get_children().size() == 4) {
         if (not is_on_new_line(ws[n.get_children()[3]->get_first_lexem_id()]))
-          print_warning(n.get_children()[3]->get_first_lexem_coordinates(),
+          print_warning(n.get_children()[3]->get_first_leaf(), "statement-on-new-line",
                         string_builder("expression following the ENDIF keyword is not on a new line.").str());
 
       } else if (n.get_children().size() == 6) {
         if (not is_on_new_line(ws[n.get_children()[4]->get_first_lexem_id() - 1])
 	    and n.get_children()[4]->get_first_leaf()->get_symbol() != symbol::comment)
-          print_warning(n.get_children()[4]->get_first_lexem_coordinates(),
+          print_warning(n.get_children()[4]->get_first_leaf(), "statement-on-new-line",
                         string_builder("expression following the ELSE keyword is not on a new line.").str());
 
         if (not is_on_new_line(ws[n.get_children()[5]->get_first_lexem_id()]))
-          print_warning(n.get_children()[5]->get_first_lexem_coordinates(),
+          print_warning(n.get_children()[5]->get_first_leaf(), "statement-on-new-line",
                         string_builder("expression following the ENDIF keyword is not on a new line.").str());
 
       }
@@ -403,11 +428,11 @@ public:
       if (   (l.get_id() == 1 and     is_on_new_line(ws[l.get_id() - 1]) and is_indented(ws[l.get_id() - 1]))
           or (l.get_id() == 1 and not is_on_new_line(ws[l.get_id() - 1]) and not ws[l.get_id() - 1].empty())
           or (l.get_id() > 1 and is_on_new_line(ws[l.get_id() - 1]) and is_indented(ws[l.get_id() - 1])))
-        print_warning(l.get_first_lexem_coordinates(),
+        print_warning(&l, "comment-indentation",
                         string_builder("comment is indented.").str());
 
       if (l.get_id() > 1 and not is_on_new_line(ws[l.get_id() - 1]) and ws[l.get_id() - 1].empty())
-        print_warning(l.get_lexem_coordinates(),
+        print_warning(&l, "trailing-comment-space",
                         string_builder("no space between expression and trailing comment.").str());
     }
       break;
@@ -415,13 +440,13 @@ public:
     case symbol::visual_comment: {
 
       if (l.get_id() > 1 and not is_on_new_line(ws[l.get_id() - 1]))
-        print_warning(l.get_lexem_coordinates(),
+        print_warning(&l, "comment-on-new-line",
                         string_builder("visual comment is not on a new line.").str());
 
       if (   (l.get_id() == 1 and     is_on_new_line(ws[l.get_id() - 1]) and is_indented(ws[l.get_id() - 1]))
           or (l.get_id() == 1 and not is_on_new_line(ws[l.get_id() - 1]) and not ws[l.get_id() - 1].empty())
           or (l.get_id() > 1 and is_on_new_line(ws[l.get_id() - 1]) and is_indented(ws[l.get_id() - 1])))
-        print_warning(l.get_first_lexem_coordinates(),
+        print_warning(&l, "comment-indentation",
                         string_builder("visual comment is indented.").str());
 
     }
@@ -429,13 +454,13 @@ public:
     case symbol::shell_escape: {
 
       if (l.get_id() > 1 and not is_on_new_line(ws[l.get_id() - 1]))
-        print_warning(l.get_first_lexem_coordinates(),
+        print_warning(&l, "comment-on-new-line",
                         string_builder("shell escape is not on a new line.").str());
 
       if (   (l.get_id() == 1 and     is_on_new_line(ws[l.get_id() - 1]) and is_indented(ws[l.get_id() - 1]))
           or (l.get_id() == 1 and not is_on_new_line(ws[l.get_id() - 1]) and not ws[l.get_id() - 1].empty())
 	  or (l.get_id() > 1 and is_on_new_line(ws[l.get_id() - 1]) and is_indented(ws[l.get_id() - 1])))
-        print_warning(l.get_first_lexem_coordinates(),
+        print_warning(&l, "comment-indentation",
                         string_builder("shell escape is indented.").str());
     }
       break;
@@ -463,12 +488,12 @@ private:
       close_parent_id(n.get_last_lexem_id());
 
     if(not ws[open_parent_id].empty())
-      print_warning(n.get_first_lexem_coordinates(),
+      print_warning(n.get_first_leaf(), "parenthesis-white-spaces",
                         string_builder("opening parenthese is followed by white space.").str());
 
 
     if(not ws[close_parent_id - 1].empty())
-      print_warning(n.get_last_lexem_coordinates(),
+      print_warning(n.get_last_leaf(), "parenthesis-white-spaces",
                         string_builder("closing parenthese is preceded by white space.").str());
 
   }
@@ -488,64 +513,149 @@ void check_white_spaces(basic_node* tree,
 }
 
 
+/*
+ *  Output of the reformatting: the white spaces and values of the
+ *  tokens are copied in one buffer of up to 64 KiB, which grows with
+ *  what is written, so that a short output costs a short buffer. It is
+ *  written to the stream when it is full, by flush, and on destruction.
+ *  The indentations and blank lines are copied from buffers of spaces
+ *  and newlines.
+ */
+class reformat_output {
+public:
+  reformat_output(std::ostream& stream)
+    : stream(stream) {}
+
+  reformat_output(const reformat_output&) = delete;
+  reformat_output& operator=(const reformat_output&) = delete;
+
+  /*
+   *  Not on a stream which failed, such as a format_comparer which
+   *  stopped the reformatting.
+   */
+  ~reformat_output() {
+    if (stream.good())
+      try {
+        flush();
+      }
+      catch (...) {}
+  }
+
+  void write(const char* data, std::size_t n) {
+    if (buffer.size() + n > buffer_size) {
+      flush();
+      if (n > buffer_size) {
+        stream.write(data, n);
+        return;
+      }
+    }
+    buffer.append(data, n);
+  }
+
+  void write(const std::string& s) {
+    write(s.data(), s.size());
+  }
+
+  void write_spaces(std::size_t n) {
+    repeat(spaces(), n);
+  }
+
+  void write_newlines(std::size_t n) {
+    repeat(newlines(), n);
+  }
+
+  void flush() {
+    stream.write(buffer.data(), buffer.size());
+    buffer.clear();
+  }
+
+private:
+  static const std::size_t buffer_size = 1 << 16;
+
+  std::ostream& stream;
+  std::string buffer;
+
+  static const std::string& spaces() {
+    static const std::string s(256, ' ');
+    return s;
+  }
+
+  static const std::string& newlines() {
+    static const std::string s(64, '\n');
+    return s;
+  }
+
+  void repeat(const std::string& pattern, std::size_t n) {
+    while (n > 0) {
+      const std::size_t count(std::min(n, pattern.size()));
+      write(pattern.data(), count);
+      n -= count;
+    }
+  }
+};
+
 class basic_ast_printer {
 public:
-  basic_ast_printer(std::ostream& stream,
+  basic_ast_printer(reformat_output& output,
 		    const std::vector<std::string>& ws)
-    : stream(stream), white_spaces(ws) {}
+    : output(output), white_spaces(ws) {}
 
   virtual ~basic_ast_printer() {}
 
   virtual void print(leaf& l) = 0;
 
 protected:
-  std::ostream& stream;
+  reformat_output& output;
   const std::vector<std::string>& white_spaces;
 };
 
 class default_ast_printer: public basic_ast_printer {
 public:
-  default_ast_printer(std::ostream& stream,
+  default_ast_printer(reformat_output& output,
 		      const std::vector<std::string>& ws,
                       std::size_t indentation)
-    : basic_ast_printer(stream, ws), indentation(indentation) {}
+    : basic_ast_printer(output, ws), indentation(indentation) {}
 
   virtual ~default_ast_printer() {}
 
+  void set_indentation(std::size_t i) { indentation = i; }
+
   virtual void print(leaf& l) {
+    const std::string& ws(basic_ast_printer::white_spaces[l.get_id() - 1]);
+
     switch (l.get_symbol()) {
     case symbol::comment:
     case symbol::visual_comment:
     case symbol::shell_escape: {
-      const std::size_t lexem_id(l.get_id()-1);
-      const std::size_t newlines(std::count(this->white_spaces[lexem_id].begin(),
-					    this->white_spaces[lexem_id].end(),'\n'));
-
-      basic_ast_printer::stream
-	<< std::string(newlines > 1 ? newlines : 1, '\n')
-	<< l.get_value();
+      const std::size_t newlines(std::count(ws.begin(), ws.end(), '\n'));
+      basic_ast_printer::output.write_newlines(newlines > 1 ? newlines : 1);
     }
       break;
 
-
     default:
-      basic_ast_printer::stream
-	<< reindent(basic_ast_printer::white_spaces[l.get_id() - 1])
-	<< l.get_value();
+      reindent(ws);
       break;
     }
+
+    basic_ast_printer::output.write(l.get_value());
   }
 
 private:
   std::size_t indentation;
 
-  std::string reindent(std::string ws) {
-    std::string::size_type nl_position(ws.rfind('\n'));
+  /*
+   *  The spaces after the last newline are replaced by the
+   *  indentation, but for the last character.
+   */
+  void reindent(const std::string& ws) {
+    const std::string::size_type nl_position(ws.rfind('\n'));
     if (nl_position == std::string::npos) {
-      return ws;
+      basic_ast_printer::output.write(ws);
     } else {
-      return ws.replace(nl_position + 1, ws.size() - nl_position - 2,
-                        std::string(indentation, ' '));
+      basic_ast_printer::output.write(ws.data(), nl_position + 1);
+      basic_ast_printer::output.write_spaces(indentation);
+      if (nl_position + 1 < ws.size())
+        basic_ast_printer::output.write(ws.data() + ws.size() - 1, 1);
     }
   }
 };
@@ -553,13 +663,21 @@ private:
 class reformat_printer: public basic_visitor {
 public:
   reformat_printer(std::ostream& stream,
-		   const std::vector<std::string>& white_spaces)
-    : stream(stream), white_spaces(white_spaces), indentation(0) {
-    printers.push_back(new default_ast_printer(stream, white_spaces, indentation));
-  }
+		   const std::vector<std::string>& white_spaces,
+		   std::size_t indentation = 0)
+    : output(stream), printer(output, white_spaces, indentation),
+      indentation(indentation) {}
 
   virtual ~reformat_printer() {}
 
+  /*
+   *  Writes what is left in the output buffer to the stream, which the
+   *  destructor does too.
+   */
+  void flush() {
+    output.flush();
+  }
+
   virtual void visit(node& n) override {
     if (n.get_production_id() == -1)
       return;
@@ -582,8 +700,7 @@ public:
     case symbol::function_call:
     case symbol::macro_file:
     case symbol::if_clause:
-      for (auto child: n.get_children())
-        child->accept(this);
+      accept_chain_children(n, this);
       break;
 
     case symbol::macro_def:
@@ -700,7 +817,7 @@ public:
     case symbol::literal_string:
     case symbol::semicolon:
     case symbol::comma:
-      printers.back()->print(l);
+      printer.print(l);
       break;
 
     default:
@@ -710,20 +827,18 @@ public:
   }
 
 private:
-  std::ostream& stream;
-  const std::vector<std::string>& white_spaces;
-  std::vector<basic_ast_printer*> printers;
+  reformat_output output;
+  default_ast_printer printer;
   std::size_t indentation;
 
   void indent() {
     indentation += 2;
-    printers.push_back(new default_ast_printer(stream, white_spaces, indentation));
+    printer.set_indentation(indentation);
   }
 
   void deindent() {
-    delete printers.back();
-    printers.pop_back();
     indentation -= 2;
+    printer.set_indentation(indentation);
   }
 };
 
@@ -732,14 +847,54 @@ void reformat(basic_node* tree,
 	      std::ostream& stream) {
   reformat_printer printer(stream, white_spaces);
   tree->accept(&printer);
+  printer.flush();
+}
+
+
+/*
+ *  The characters of a text which are special in the content of html
+ *  elements, replaced by their entity.
+ */
+std::string html_escape(const std::string& text) {
+  std::string result;
+  result.reserve(text.size());
+  for (const char c: text) {
+    switch (c) {
+    case '<': result += "&lt;"; break;
+    case '>': result += "&gt;"; break;
+    case '&': result += "&amp;"; break;
+    default: result += c; break;
+    }
+  }
+  return result;
 }
 
 
+/*
+ *  Where the highlighted references to other files point to.
+ */
+class html_links {
+public:
+  virtual ~html_links() {}
+
+  /*
+   *  The href of an @input file name or of a macro name, or an empty
+   *  string for no link.
+   */
+  virtual std::string get_href(dependency_kind kind, const std::string& name) const = 0;
+};
+
+
+/*
+ *  Without links, the global macro names link to nowhere, and the
+ *  other references are not links.
+ */
 class html_highlight_printer: public basic_visitor {
 public:
   html_highlight_printer(std::ostream& stream,
-                         const std::vector<std::string>& white_spaces)
-    : stream(stream), white_spaces(white_spaces) {}
+                         const std::vector<std::string>& white_spaces,
+                         const html_links* links = nullptr)
+    : stream(stream), white_spaces(white_spaces), links(links) {}
 
   virtual ~html_highlight_printer() {}
 
@@ -751,7 +906,6 @@ public:
     case symbol::start:
     case symbol::stmt_list:
     case symbol::stmt:
-    case symbol::input:
     case symbol::macro_call:
     case symbol::macro_name:
     case symbol::macro_arg_list:
@@ -768,8 +922,14 @@ public:
     case symbol::macro_def:
     case symbol::if_stmt:
     case symbol::for_stmt:
-      for (auto child: n.get_children())
-        child->accept(this);
+      accept_chain_children(n, this);
+      break;
+
+    case symbol::input:
+      n.get_children()[0]->accept(this);
+      if (links)
+        href = links->get_href(dependency_kind::input, get_input_filename(&n));
+      n.get_children()[1]->accept(this);
       break;
 
 
@@ -782,6 +942,17 @@ public:
   virtual void visit(leaf& l) override {
     stream << white_spaces[l.get_id() - 1];
 
+    if (links and l.get_symbol() == symbol::global_macro_name)
+      href = links->get_href(dependency_kind::global_macro, l.get_value());
+    else if (links and l.get_symbol() == symbol::local_macro_name)
+      href = links->get_href(dependency_kind::local_macro, l.get_value());
+    else if (not links and l.get_symbol() == symbol::global_macro_name)
+      href = "#";
+
+    if (not href.empty())
+      stream << "<a href=\"" << href << "\">";
+
+    const std::string value(html_escape(l.get_value()));
     switch (l.get_symbol()) {
     case symbol::at:
     case symbol::if_kw:
@@ -798,50 +969,45 @@ public:
     case symbol::defmacro_kw:
     case symbol::enddefmacro_kw:
       stream << "<span class=\"alucell-keyword\">";
-      stream << l.get_value();
+      stream << value;
       stream << "</span>";
       break;
       
     case symbol::inline_macro_name:
     case symbol::local_macro_name:
+    case symbol::global_macro_name:
       stream << "<span class=\"alucell-macro\">";
-      stream << l.get_value();
+      stream << value;
       stream << "</span>";
       break;
       
-    case symbol::global_macro_name:
-      stream << "<a href=\"#\"><span class=\"alucell-macro\">";
-      stream << l.get_value();
-      stream << "</span></a>";
-      break;
-      
     case symbol::comment:
       stream << "<span class=\"alucell-comment\">";
-      stream << l.get_value();
+      stream << value;
       stream << "</span>";
       break;
       
     case symbol::visual_comment:
       stream << "<span class=\"alucell-visual-comment\">";
-      stream << l.get_value();
+      stream << value;
       stream << "</span>";
       break;
       
     case symbol::shell_escape:
       stream << "<span class=\"alucell-shell-escape\">";
-      stream << l.get_value();
+      stream << value;
       stream << "</span>";
       break;
       
     case symbol::fp_number:
       stream << "<span class=\"alucell-number\">";
-      stream << l.get_value();
+      stream << value;
       stream << "</span>";
       break;
       
     case symbol::literal_string:
       stream << "<span class=\"alucell-string\">";
-      stream << l.get_value();
+      stream << value;
       stream << "</span>";
       break;
       
@@ -858,24 +1024,35 @@ public:
     case symbol::rb:
     case symbol::semicolon:
     case symbol::comma:
-      stream << l.get_value();
+      stream << value;
       break;
 
     default:
       throw std::string("this should not happen: unhandled terminal symbol");
       break;
     }
+
+    if (not href.empty())
+      stream << "</a>";
+    href.clear();
   }
 
 private:
   std::ostream& stream;
   const std::vector<std::string>& white_spaces;
+  const html_links* links;
+
+  /*
+   *  The link around the next token, if any.
+   */
+  std::string href;
 };
 
 void html_highlight(basic_node* tree,
                     const std::vector<std::string>& white_spaces,
-                    std::ostream& stream) {
-  html_highlight_printer printer(stream, white_spaces);
+                    std::ostream& stream,
+                    const html_links* links = nullptr) {
+  html_highlight_printer printer(stream, white_spaces, links);
   stream << "<pre><code>";
   tree->accept(&printer);
   stream << "</pre></code>";
@@ -43,15 +43,45 @@ public:
   node(symbol s, int production_id,
        iterator_type begin, iterator_type end): basic_node(s), production_id(production_id), children(begin, end) {}
 
+  /*
+   *  The descendants are deleted from a stack rather than recursively,
+   *  since the lists and expressions are as deep as they are long.
+   */
+  virtual ~node() {
+    std::vector<basic_node*> pending;
+    release_children(pending);
+    while (not pending.empty()) {
+      basic_node* n(pending.back());
+      pending.pop_back();
+      node* inner(dynamic_cast<node*>(n));
+      if (inner)
+        inner->release_children(pending);
+      delete n;
+    }
+  }
+
   void show(std::ostream& stream, unsigned int level) const {
-    stream << std::string(level, ' ') << s;
-    if (production_id == -1)
-      stream << "[recovered from error]" << std::endl;
-    else
-      stream << std::endl;
-    
-    for (const auto& c: children)
-      c->show(stream, level + 2);
+    std::vector<std::pair<const basic_node*, unsigned int> > pending(1, std::make_pair(this, level));
+    while (not pending.empty()) {
+      const basic_node* n(pending.back().first);
+      const unsigned int l(pending.back().second);
+      pending.pop_back();
+
+      const node* inner(dynamic_cast<const node*>(n));
+      if (not inner) {
+        n->show(stream, l);
+        continue;
+      }
+
+      stream << std::string(l, ' ') << inner->s;
+      if (inner->production_id == -1)
+        stream << "[recovered from error]" << std::endl;
+      else
+        stream << std::endl;
+
+      for (auto c(inner->children.rbegin()); c != inner->children.rend(); ++c)
+        pending.push_back(std::make_pair(*c, l + 2));
+    }
   }
 
   virtual void accept(basic_visitor* v) {
@@ -64,33 +94,56 @@ public:
     return children;
   }
 
-  virtual const leaf* get_first_leaf() const {
-    return children.front()->get_first_leaf();
-  }
-  
-  virtual const leaf* get_last_leaf() const {
-    return children.back()->get_last_leaf();
-  }
-  
-  std::size_t get_first_lexem_id() const {
-    return children.front()->get_first_lexem_id();
+  /*
+   *  Replace the i-th child and return the previous one, which is no
+   *  longer owned by this node.
+   */
+  basic_node* replace_child(std::size_t i, basic_node* c) {
+    basic_node* previous(children[i]);
+    children[i] = c;
+    return previous;
   }
 
-  std::size_t get_last_lexem_id() const {
-    return children.back()->get_last_lexem_id();
+  /*
+   *  The next node of a right recursive list or expression, as
+   *  stmt_list or term: the last child when it has the same symbol, or
+   *  nullptr. The visitors follow these chains in a loop, since they
+   *  are as deep as the lists are long.
+   */
+  node* get_chain_next() const {
+    return children.back()->get_symbol() == s ? static_cast<node*>(children.back()) : nullptr;
   }
 
-  const source_coordinate_range* get_first_lexem_coordinates() const {
-    return children.front()->get_first_lexem_coordinates();
-  }
+  virtual const leaf* get_first_leaf() const;
+  virtual const leaf* get_last_leaf() const;
+  
+  std::size_t get_first_lexem_id() const;
+  std::size_t get_last_lexem_id() const;
 
-  const source_coordinate_range* get_last_lexem_coordinates() const {
-    return children.back()->get_last_lexem_coordinates();
-  }
+  const source_coordinate_range* get_first_lexem_coordinates() const;
+  const source_coordinate_range* get_last_lexem_coordinates() const;
   
 private:
   int production_id;
   std::vector<basic_node*> children;
+
+  void release_children(std::vector<basic_node*>& released) {
+    released.insert(released.end(), children.begin(), children.end());
+    children.clear();
+  }
+};
+
+
+/*
+ *  Shift of the lexem ids and lines of the leaves of a statement moved
+ *  by an edit of the text, shared by its leaves, which keep the ones
+ *  they were lexed with.
+ */
+struct lexem_shift {
+  lexem_shift(): ids(0), lines(0) {}
+
+  std::ptrdiff_t ids;
+  std::ptrdiff_t lines;
 };
 
 
@@ -99,12 +152,20 @@ public:
   leaf(symbol s, const std::string& v,
        source_coordinate_range* coord,
        std::size_t lexem_id)
-    : basic_node(s), value(v), id(lexem_id), coordinates(coord) {}
+    : basic_node(s), value(v), id(lexem_id), coordinates(coord), shift(nullptr) {}
+
+  virtual ~leaf() {
+    delete coordinates;
+  }
 
   void show(std::ostream& stream, unsigned int level) const {
     stream << std::string(level, ' ') << s <<" (" << value << ", "
-           << id << ", "
-           << coordinates->render() << ")" << std::endl;
+           << get_id() << ", ";
+    if (shift and shift->lines)
+      stream << lexed_coordinates()->get_filename() << ":" << get_line() << ":" << get_column();
+    else
+      stream << coordinates->render();
+    stream << ")" << std::endl;
   }
 
   virtual void accept(basic_visitor* v) {
@@ -115,7 +176,20 @@ public:
     return value;
   }
 
-  std::size_t get_id() const { return id; }
+  std::size_t get_id() const { return shift ? id + shift->ids : id; }
+
+  /*
+   *  The position of the lexem in the text, including the shift of the
+   *  statement. The coordinates are the ones it was lexed with.
+   */
+  std::size_t get_line() const {
+    const std::size_t line(lexed_coordinates()->get_line());
+    return shift ? line + shift->lines : line;
+  }
+
+  std::size_t get_column() const { return lexed_coordinates()->get_column(); }
+
+  void set_shift(const lexem_shift* statement_shift) { shift = statement_shift; }
 
   virtual const leaf* get_first_leaf() const {
     return this;
@@ -149,6 +223,59 @@ private:
   std::string value;
   std::size_t id;
   source_coordinate_range* coordinates;
+  const lexem_shift* shift;
+
+  const file_source_coordinate_range* lexed_coordinates() const {
+    return dynamic_cast<const file_source_coordinate_range*>(coordinates);
+  }
 };
 
+
+inline const leaf* node::get_first_leaf() const {
+  const basic_node* n(this);
+  while (const node* inner = dynamic_cast<const node*>(n))
+    n = inner->children.front();
+  return static_cast<const leaf*>(n);
+}
+
+inline const leaf* node::get_last_leaf() const {
+  const basic_node* n(this);
+  while (const node* inner = dynamic_cast<const node*>(n))
+    n = inner->children.back();
+  return static_cast<const leaf*>(n);
+}
+
+inline std::size_t node::get_first_lexem_id() const {
+  return get_first_leaf()->get_id();
+}
+
+inline std::size_t node::get_last_lexem_id() const {
+  return get_last_leaf()->get_id();
+}
+
+inline const source_coordinate_range* node::get_first_lexem_coordinates() const {
+  return get_first_leaf()->get_lexem_coordinates();
+}
+
+inline const source_coordinate_range* node::get_last_lexem_coordinates() const {
+  return get_last_leaf()->get_lexem_coordinates();
+}
+
+
+/*
+ *  Accepts a visitor on the children of a node and of the rest of its
+ *  chain, but for the links of the chain, in a loop. The nodes of the
+ *  chain recovered from an error are skipped unless recovered is set,
+ *  as the checkers do.
+ */
+inline void accept_chain_children(node& n, basic_visitor* v, bool recovered = false) {
+  for (node* c(&n); c and (recovered or c->get_production_id() != -1); ) {
+    node* next(c->get_chain_next());
+    const std::vector<basic_node*>& children(c->get_children());
+    for (std::size_t i(0); i + (next ? 1 : 0) < children.size(); ++i)
+      children[i]->accept(v);
+    c = next;
+  }
+}
+
 #endif /* SYNTAX_TREE_H */
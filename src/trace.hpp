@@ -0,0 +1,132 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <string>
+#include <fstream>
+#include <sstream>
+#include <chrono>
+#include <mutex>
+#include <atomic>
+
+#include "json.hpp"
+
+
+/*
+ *  Writes the spans of a run as Chrome trace events, which the Chrome
+ *  and Perfetto trace viewers open. Each span is written when it ends,
+ *  by whichever thread, and tagged with the thread it ran on; spans
+ *  nested in time on a thread are shown nested.
+ *
+ *  The events are a bare JSON array, which the viewers accept without
+ *  its closing bracket: the trace of a server which is killed can
+ *  still be opened.
+ */
+class trace_writer {
+public:
+  using clock = std::chrono::steady_clock;
+
+  trace_writer(): origin(clock::now()), events(0), enabled(false) {}
+
+  ~trace_writer() {
+    close();
+  }
+
+  void open(const std::string& filename) {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (enabled)
+      return;
+    file.open(filename.c_str(), std::ios::out | std::ios::trunc);
+    if (not file)
+      throw std::string("error: could not open ") + filename;
+    file << '[';
+    events = 0;
+    enabled = true;
+  }
+
+  void close() {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (not enabled)
+      return;
+    file << "\n]" << std::endl;
+    file.close();
+    enabled = false;
+  }
+
+  bool is_enabled() const { return enabled; }
+
+  clock::time_point now() const { return clock::now(); }
+
+  /*
+   *  A complete event; argument is the file the span refers to, if
+   *  any.
+   */
+  void add_span(const std::string& name, clock::time_point start, clock::time_point end,
+                const std::string& argument = "") {
+    if (not enabled)
+      return;
+
+    std::ostringstream event;
+    event << "{\"name\":\"" << json_escape(name) << "\",\"cat\":\"alint\",\"ph\":\"X\""
+          << ",\"ts\":" << microseconds(start - origin)
+          << ",\"dur\":" << microseconds(end - start)
+          << ",\"pid\":1,\"tid\":" << thread_id();
+    if (not argument.empty())
+      event << ",\"args\":{\"file\":\"" << json_escape(argument) << "\"}";
+    event << '}';
+
+    std::lock_guard<std::mutex> lock(mutex);
+    if (enabled)
+      file << (events++ ? ",\n" : "\n") << event.str();
+  }
+
+private:
+  static double microseconds(clock::duration d) {
+    return std::chrono::duration<double, std::micro>(d).count();
+  }
+
+  /*
+   *  Small thread numbers, in the order the threads first trace
+   *  something.
+   */
+  static unsigned int thread_id() {
+    static std::atomic<unsigned int> next(1);
+    static thread_local unsigned int id(next++);
+    return id;
+  }
+
+  clock::time_point origin;
+  std::ofstream file;
+  std::size_t events;
+  std::atomic<bool> enabled;
+  std::mutex mutex;
+};
+
+
+inline
+trace_writer& default_trace() {
+  static trace_writer t;
+  return t;
+}
+
+
+/*
+ *  Traces the time spent in its scope.
+ */
+class trace_span {
+public:
+  trace_span(const std::string& name, const std::string& argument = "")
+    : name(name), argument(argument), start(default_trace().now()) {}
+
+  ~trace_span() {
+    trace_writer& t(default_trace());
+    if (t.is_enabled())
+      t.add_span(name, start, t.now(), argument);
+  }
+
+private:
+  std::string name;
+  std::string argument;
+  trace_writer::clock::time_point start;
+};
+
+#endif /* TRACE_H */
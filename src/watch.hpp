@@ -0,0 +1,152 @@
+#ifndef WATCH_H
+#define WATCH_H
+
+#include <map>
+#include <set>
+#include <string>
+#include <vector>
+
+#include <dirent.h>
+#include <poll.h>
+#include <unistd.h>
+#include <sys/inotify.h>
+#include <sys/stat.h>
+
+#include "file_utils.hpp"
+
+
+/*
+ *  inotify based watcher of directory trees. Changes are reported in
+ *  batches: once a first event arrives, events are accumulated until
+ *  the directories have been quiet for a while, such that the bursts
+ *  of writes and renames of an editor save are reported once.
+ */
+class directory_watcher {
+public:
+  directory_watcher(): fd(inotify_init1(IN_CLOEXEC)) {
+    if (fd < 0)
+      throw std::string("error: could not initialize inotify.");
+  }
+
+  directory_watcher(const directory_watcher&) = delete;
+  directory_watcher& operator=(const directory_watcher&) = delete;
+
+  ~directory_watcher() {
+    close(fd);
+  }
+
+  /*
+   *  Watch the directory and its sub-directories. The regular files
+   *  found along the way are appended to files.
+   */
+  void add_directory(const std::string& directory, std::vector<std::string>& files) {
+    if (not add_tree(directory, files))
+      throw std::string("error: could not watch ") + directory;
+  }
+
+  /*
+   *  Block until something changes, then wait for quiet_period
+   *  milliseconds without events before returning the changed files.
+   */
+  std::set<std::string> wait_for_changes(int quiet_period) {
+    std::set<std::string> changed;
+    while (changed.empty())
+      read_events(-1, changed);
+
+    while (read_events(quiet_period, changed))
+      ;
+
+    return changed;
+  }
+
+private:
+  int fd;
+  std::map<int, std::string> directories;
+
+  /*
+   *  The symbolic links to directories are not followed, so that a
+   *  link to a parent does not recurse. The sub-directories which
+   *  vanish before they are watched are skipped. Returns false if
+   *  directory itself can't be watched.
+   */
+  bool add_tree(const std::string& directory, std::vector<std::string>& files) {
+    const int wd(inotify_add_watch(fd, directory.c_str(),
+                                   IN_CLOSE_WRITE | IN_MOVED_TO | IN_MOVED_FROM
+                                   | IN_CREATE | IN_DELETE | IN_DELETE_SELF | IN_ONLYDIR | IN_DONT_FOLLOW));
+    if (wd < 0)
+      return false;
+    directories[wd] = directory;
+
+    DIR* dir(opendir(directory.c_str()));
+    if (not dir)
+      return true;
+
+    while (const dirent* entry = readdir(dir)) {
+      const std::string name(entry->d_name);
+      if (name == "." or name == "..")
+        continue;
+
+      const std::string path(directory + "/" + name);
+      struct stat s;
+      if (lstat(path.c_str(), &s) != 0)
+        continue;
+
+      if (S_ISDIR(s.st_mode))
+        add_tree(path, files);
+      else if (S_ISREG(s.st_mode) or (S_ISLNK(s.st_mode) and stat(path.c_str(), &s) == 0
+                                      and S_ISREG(s.st_mode)))
+        files.push_back(path);
+    }
+    closedir(dir);
+    return true;
+  }
+
+  /*
+   *  Returns false if no event arrived before the timeout.
+   */
+  bool read_events(int timeout, std::set<std::string>& changed) {
+    pollfd p;
+    p.fd = fd;
+    p.events = POLLIN;
+    if (poll(&p, 1, timeout) <= 0)
+      return false;
+
+    alignas(inotify_event) char buffer[65536];
+    const ssize_t length(read(fd, buffer, sizeof(buffer)));
+    if (length <= 0)
+      return false;
+
+    for (ssize_t offset(0); offset < length;) {
+      const inotify_event* event(reinterpret_cast<const inotify_event*>(buffer + offset));
+      offset += sizeof(inotify_event) + event->len;
+
+      const auto directory(directories.find(event->wd));
+      if (directory == directories.end())
+        continue;
+
+      if (event->mask & IN_IGNORED) {
+        directories.erase(directory);
+        continue;
+      }
+
+      if (not event->len)
+        continue;
+
+      const std::string path(directory->second + "/" + event->name);
+      if (event->mask & IN_ISDIR) {
+        if (event->mask & (IN_CREATE | IN_MOVED_TO)) {
+          std::vector<std::string> files;
+          add_tree(path, files);
+          changed.insert(files.begin(), files.end());
+        }
+      } else if (not (event->mask & IN_CREATE)) {
+        // a created file is reported when it is closed after writing
+        changed.insert(path);
+      }
+    }
+
+    return true;
+  }
+};
+
+#endif /* WATCH_H */
@@ -0,0 +1,174 @@
+#include <fstream>
+#include <sstream>
+#include <chrono>
+#include <functional>
+
+#include <cstdlib>
+#include <cstdio>
+
+#include <spikes/timer.hpp>
+
+#include <parser/parser.hpp>
+#include <lexer/lexer.hpp>
+#include "../src/token_source.hpp"
+
+#include "../src/symbol.hpp"
+#include "../src/lexer.hpp"
+#include "../src/syntax_tree.hpp"
+#include "../src/parser.hpp"
+#include "../src/syntax_checkers.hpp"
+
+
+/*
+ *  Lexes, parses, checks, reformats and reports the diagnostics of
+ *  hostile inputs, each at four sizes doubling from the given one, 64
+ *  KiB by default, and checks that the time grows linearly with the
+ *  size: from one size to the next, the time may grow by 2 times a
+ *  tolerance for the noise, 1.5 by default. It runs on the default
+ *  stack: the nesting past the limit of the budget stops with a
+ *  diagnostic, and the long lists and expressions are walked in loops.
+ */
+
+using token_type = token<symbol>;
+using clock_type = std::chrono::steady_clock;
+
+std::string repeat(const std::string& s, std::size_t size) {
+  std::string result;
+  result.reserve(size + s.size());
+  while (result.size() < size)
+    result += s;
+  return result;
+}
+
+struct hostile_input {
+  std::string name;
+  std::function<std::string(std::size_t)> generate;
+};
+
+const std::vector<hostile_input> inputs = {
+  { "long identifier", [](std::size_t n) { return repeat("a", n) + "\nendmacro\n"; } },
+  { "identifier groups", [](std::size_t n) { return repeat("x#{a}", n) + "\nendmacro\n"; } },
+  { "unterminated group", [](std::size_t n) { return "x#{" + repeat("a", n) + "\nendmacro\n"; } },
+  { "unterminated groups", [](std::size_t n) { return repeat("x#{a ", n) + "\nendmacro\n"; } },
+  { "unterminated string", [](std::size_t n) { return "(a=\"" + repeat("a ", n) + "\nendmacro\n"; } },
+  { "unterminated guard", [](std::size_t n) { return "FOR i=1 TO 2 DO(\"" + repeat("a", n) + "\nendmacro\n"; } },
+  { "long number", [](std::size_t n) { return "(a=" + repeat("1", n) + ")\nendmacro\n"; } },
+  { "exponents", [](std::size_t n) { return "(a=" + repeat("1e1", n) + ")\nendmacro\n"; } },
+  { "invalid bytes", [](std::size_t n) { return repeat("`~&|?<>[]\x01\x7f", n) + "\nendmacro\n"; } },
+  { "invalid lines", [](std::size_t n) { return repeat("`\n", n) + "endmacro\n"; } },
+  { "nested for", [](std::size_t n) {
+      const std::size_t depth(n / 64);
+      std::string s;
+      for (std::size_t i(0); i < depth; ++i)
+        s += "FOR i=1 TO 2 DO(\"l\")\n";
+      s += "(a=1)\n";
+      for (std::size_t i(0); i < depth; ++i)
+        s += "ENDDO(\"l\")\n";
+      return s + "endmacro\n";
+    } },
+  { "nested if", [](std::size_t n) {
+      const std::size_t depth(n / 64);
+      return repeat("IF (a) THEN\n", depth * 12) + "(a=1)\n" + repeat("ENDIF\n", depth * 6) + "endmacro\n";
+    } },
+  { "nested parentheses", [](std::size_t n) {
+      return "(a=" + repeat("(", n / 2) + "1" + repeat(")", n / 2) + ")\nendmacro\n";
+    } },
+  { "long expression", [](std::size_t n) { return "(a=" + repeat("b+", n) + "1)\nendmacro\n"; } },
+};
+
+
+double elapsed_since(clock_type::time_point start) {
+  return std::chrono::duration<double, std::milli>(clock_type::now() - start).count();
+}
+
+/*
+ *  The time to lex, parse, check and report the diagnostics of a file.
+ */
+double analyse(const std::string& filename,
+               lr_parser<symbol>& p, cf_grammar<symbol>& g,
+               alint_token_source& tokens) {
+  const clock_type::time_point start(clock_type::now());
+  try {
+    tokens.set_file(filename);
+    tokens.lex_to_end();
+  }
+  catch (const limit_exceeded& e) {
+    e.report();
+    std::ostringstream output;
+    default_diagnostic_sink().flush(output);
+    return elapsed_since(start);
+  }
+
+  const std::vector<token_type*>& lexems(tokens.get_lexems());
+  token_replay_source input(lexems.data(), lexems.data() + lexems.size(), 1);
+  tree_factory<symbol> factory;
+  silent_error_handler<token_type> handler;
+  basic_node* tree(nullptr);
+  try {
+    tree = parse_input_to_tree<token_replay_source,
+                               tree_factory<symbol>,
+                               default_error_handler<token_type> >(p, g, input, factory, handler);
+  }
+  catch (const parse_error<token_type>&) {
+  }
+
+  if (tree) {
+    check_do_enddo_guards(tree);
+    check_white_spaces(tree, tokens.get_white_spaces());
+    std::ostringstream formatted;
+    reformat(tree, tokens.get_white_spaces(), formatted);
+    delete tree;
+  }
+
+  std::ostringstream output;
+  default_diagnostic_sink().flush(output);
+  return elapsed_since(start);
+}
+
+
+int main(int argc, char** argv) {
+  try {
+    const std::size_t size(argc > 1 ? std::atoi(argv[1]) : 65536);
+    const double tolerance(argc > 2 ? std::atof(argv[2]) : 1.5);
+    const std::string filename("/tmp/alint_adversarial.mac");
+
+    cf_grammar<symbol> g(build_cf_grammar());
+    lr_parser<symbol> p(g);
+    alint_token_source tokens;
+
+    bool linear(true);
+    for (const auto& i: inputs) {
+      std::vector<double> times;
+      std::cout << i.name << ":";
+      for (std::size_t n(size); n <= 8 * size; n *= 2) {
+        {
+          std::ofstream file(filename.c_str(), std::ios::out | std::ios::trunc | std::ios::binary);
+          file << i.generate(n);
+        }
+        /*
+         *  The best of three, since a single slow run is noise.
+         */
+        double best(analyse(filename, p, g, tokens));
+        for (std::size_t r(0); r < 2; ++r)
+          best = std::min(best, analyse(filename, p, g, tokens));
+        times.push_back(best);
+        std::cout << " " << best << "ms";
+      }
+
+      bool growth_ok(true);
+      for (std::size_t k(1); k < times.size(); ++k)
+        growth_ok = growth_ok and times[k] <= 2.0 * tolerance * std::max(times[k - 1], 1.0);
+      std::cout << (growth_ok ? "" : "  super-linear") << std::endl;
+      linear = linear and growth_ok;
+    }
+    std::remove(filename.c_str());
+
+    if (not linear)
+      throw std::string("some inputs take super-linear time.");
+  }
+  catch (const std::string& e) {
+    std::cout << e << std::endl;
+    return 1;
+  }
+  return 0;
+}
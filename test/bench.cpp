@@ -0,0 +1,311 @@
+#include <fstream>
+#include <sstream>
+#include <iomanip>
+#include <chrono>
+#include <algorithm>
+#include <numeric>
+#include <queue>
+#include <cmath>
+
+#include <cstdlib>
+
+#include <dirent.h>
+
+#include <spikes/timer.hpp>
+
+#include <parser/parser.hpp>
+#include <lexer/lexer.hpp>
+#include "../src/token_source.hpp"
+
+#include "../src/symbol.hpp"
+#include "../src/lexer.hpp"
+#include "../src/syntax_tree.hpp"
+#include "../src/parser.hpp"
+#include "../src/syntax_checkers.hpp"
+
+
+/*
+ *  Times each phase of alint over all the macros of a corpus, such as
+ *  the one generate_corpus writes: lexing, parsing, the checkers, the
+ *  crawl of the dependencies of each deck, reformatting and the html
+ *  output. The corpus is processed the given number of times, and the
+ *  median and standard deviation of each phase are compared with a
+ *  baseline file, or saved into it when the last argument is "save".
+ *  Exits with 1 if a phase is significantly slower than its baseline,
+ *  or if the baseline given can't be read.
+ *
+ *  usage: bench corpus_directory [runs=5] [baseline] [save]
+ */
+
+using token_type = token<symbol>;
+using clock_type = std::chrono::steady_clock;
+
+const std::vector<std::string> phases = {
+  "lex", "parse", "check", "dependencies", "reformat", "html"
+};
+
+
+void list_macro_files(const std::string& directory, std::vector<std::string>& files) {
+  DIR* d(opendir(directory.c_str()));
+  if (not d)
+    throw std::string("could not open ") + directory;
+
+  while (const dirent* entry = readdir(d)) {
+    const std::string name(entry->d_name);
+    if (name == "." or name == "..")
+      continue;
+    const std::string path(directory + "/" + name);
+    if (entry->d_type == DT_DIR)
+      list_macro_files(path, files);
+    else if (is_macro_file(name))
+      files.push_back(path);
+  }
+  closedir(d);
+}
+
+double elapsed_since(clock_type::time_point start) {
+  return std::chrono::duration<double, std::milli>(clock_type::now() - start).count();
+}
+
+
+struct parsed_macro {
+  std::string filename;
+  basic_node* tree;
+  std::vector<std::string> white_spaces;
+};
+
+
+/*
+ *  One pass over the corpus, returns the time of each phase in
+ *  milliseconds.
+ */
+std::map<std::string, double> run_once(const std::vector<std::string>& files,
+                                       const options& opt,
+                                       lr_parser<symbol>& p,
+                                       cf_grammar<symbol>& g,
+                                       alint_token_source& tokens) {
+  std::map<std::string, double> times;
+  for (const auto& phase: phases)
+    times[phase] = 0.0;
+
+  std::vector<parsed_macro> parsed;
+  for (const auto& f: files) {
+    clock_type::time_point start(clock_type::now());
+    tokens.set_file(f);
+    tokens.lex_to_end();
+    times["lex"] += elapsed_since(start);
+
+    const std::vector<token_type*>& lexems(tokens.get_lexems());
+    token_replay_source input(lexems.data(), lexems.data() + lexems.size(), 1);
+    tree_factory<symbol> factory;
+    silent_error_handler<token_type> handler;
+    start = clock_type::now();
+    basic_node* tree(parse_input_to_tree<token_replay_source,
+                                         tree_factory<symbol>,
+                                         default_error_handler<token_type> >(p, g, input, factory, handler));
+    times["parse"] += elapsed_since(start);
+
+    if (not tree)
+      throw std::string("could not parse ") + f;
+    parsed.push_back(parsed_macro{f, tree, tokens.get_white_spaces()});
+  }
+
+  std::vector<diagnostic> diagnostics;
+  diagnostic_collector() = &diagnostics;
+  clock_type::time_point start(clock_type::now());
+  for (const auto& m: parsed) {
+    check_do_enddo_guards(m.tree);
+    check_white_spaces(m.tree, m.white_spaces);
+  }
+  times["check"] += elapsed_since(start);
+  diagnostic_collector() = nullptr;
+
+  /*
+   *  The transitive dependencies of each deck, the files at the root
+   *  of the corpus.
+   */
+  start = clock_type::now();
+  std::map<std::string, dependency_list> dependencies;
+  for (const auto& m: parsed)
+    dependencies[m.filename] = extract_dependencies(m.tree, opt);
+  std::size_t edges(0);
+  for (const auto& m: parsed) {
+    if (m.filename.find("/global/") != std::string::npos
+        or m.filename.find("/local/") != std::string::npos)
+      continue;
+    std::set<std::string> visited;
+    std::queue<std::string> unvisited;
+    unvisited.push(m.filename);
+    while (not unvisited.empty()) {
+      const std::string f(unvisited.front());
+      unvisited.pop();
+      if (not visited.insert(f).second)
+        continue;
+      for (const auto& d: dependencies[f]) {
+        ++edges;
+        unvisited.push(d.first);
+      }
+    }
+  }
+  times["dependencies"] += elapsed_since(start);
+
+  std::size_t size(0);
+  start = clock_type::now();
+  for (const auto& m: parsed) {
+    std::ostringstream output;
+    reformat(m.tree, m.white_spaces, output);
+    size += output.tellp();
+  }
+  times["reformat"] += elapsed_since(start);
+
+  start = clock_type::now();
+  for (const auto& m: parsed) {
+    std::ostringstream output;
+    html_highlight(m.tree, m.white_spaces, output);
+    size += output.tellp();
+  }
+  times["html"] += elapsed_since(start);
+
+  for (auto& m: parsed)
+    delete m.tree;
+
+  if (edges == 0 or size == 0)
+    throw std::string("the corpus has no dependency or no output.");
+  return times;
+}
+
+
+struct phase_summary {
+  phase_summary(): median(0.0), stddev(0.0) {}
+
+  double median;
+  double stddev;
+};
+
+phase_summary summarize(std::vector<double> samples) {
+  phase_summary s;
+  std::sort(samples.begin(), samples.end());
+  const std::size_t n(samples.size());
+  s.median = n % 2 ? samples[n / 2] : (samples[n / 2 - 1] + samples[n / 2]) / 2.0;
+
+  const double mean(std::accumulate(samples.begin(), samples.end(), 0.0) / n);
+  double variance(0.0);
+  for (const double x: samples)
+    variance += (x - mean) * (x - mean);
+  s.stddev = n > 1 ? std::sqrt(variance / (n - 1)) : 0.0;
+  return s;
+}
+
+std::map<std::string, phase_summary> read_baseline(const std::string& filename) {
+  std::map<std::string, phase_summary> baseline;
+  std::ifstream file(filename.c_str());
+  if (not file)
+    throw std::string("could not read the baseline ") + filename
+      + ", run make bench-baseline first.";
+
+  std::string line;
+  while (std::getline(file, line)) {
+    if (line.empty() or line[0] == '#')
+      continue;
+    std::istringstream fields(line);
+    std::string phase;
+    phase_summary s;
+    if (fields >> phase >> s.median >> s.stddev)
+      baseline[phase] = s;
+  }
+  if (baseline.empty())
+    throw std::string("no phase in the baseline ") + filename;
+  return baseline;
+}
+
+
+int main(int argc, char** argv) {
+  try {
+    if (argc < 2)
+      throw std::string("usage: bench corpus_directory [runs] [baseline] [save]");
+    const std::string directory(argv[1]);
+    const std::size_t runs(argc > 2 ? std::atoi(argv[2]) : 5);
+    const std::string baseline_file(argc > 3 ? argv[3] : "");
+    const bool save(argc > 4 and std::string(argv[4]) == "save");
+    if (runs == 0)
+      throw std::string("the number of runs must be positive.");
+    const std::map<std::string, phase_summary> baseline(
+      baseline_file.empty() or save ? std::map<std::string, phase_summary>()
+                                    : read_baseline(baseline_file));
+
+    std::vector<std::string> files;
+    list_macro_files(directory, files);
+    std::sort(files.begin(), files.end());
+    if (files.empty())
+      throw std::string("no macro file in ") + directory;
+
+    options opt;
+    opt.global_macro_dir = directory + "/global/";
+    opt.local_macro_dir = directory + "/local/";
+
+    clock_type::time_point start(clock_type::now());
+    cf_grammar<symbol> g(build_cf_grammar());
+    lr_parser<symbol> p(g);
+    alint_token_source tokens;
+    std::cout << files.size() << " files, setup: " << elapsed_since(start) << "ms" << std::endl;
+
+    /*
+     *  A first pass warms the caches and is not measured.
+     */
+    run_once(files, opt, p, g, tokens);
+    std::map<std::string, std::vector<double> > samples;
+    for (std::size_t r(0); r < runs; ++r)
+      for (const auto& t: run_once(files, opt, p, g, tokens))
+        samples[t.first].push_back(t.second);
+
+    bool regression(false);
+    std::ostringstream saved;
+    saved << "# phase median_ms stddev_ms, " << files.size() << " files, "
+          << runs << " runs" << std::endl;
+    std::cout << std::left << std::setw(14) << "phase" << std::right
+              << std::setw(12) << "median ms" << std::setw(12) << "stddev ms"
+              << std::setw(14) << "baseline ms" << std::setw(10) << "change" << std::endl;
+    for (const auto& phase: phases) {
+      const phase_summary s(summarize(samples[phase]));
+      saved << phase << " " << s.median << " " << s.stddev << std::endl;
+
+      std::cout << std::left << std::setw(14) << phase << std::right << std::fixed
+                << std::setprecision(2) << std::setw(12) << s.median << std::setw(12) << s.stddev;
+      const auto b(baseline.find(phase));
+      if (b != baseline.end() and b->second.median > 0.0) {
+        /*
+         *  Slower by more than 5% and by more than the noise of both
+         *  measures.
+         */
+        const double change(s.median / b->second.median - 1.0);
+        const bool slower(change > 0.05
+                          and s.median - b->second.median
+                          > 3.0 * std::max(s.stddev, b->second.stddev));
+        regression = regression or slower;
+        std::cout << std::setw(14) << b->second.median << std::setw(9) << std::showpos
+                  << change * 100.0 << std::noshowpos << "%" << (slower ? "  slower" : "");
+      }
+      else if (not baseline.empty())
+        std::cout << std::setw(14) << "none";
+      std::cout << std::endl;
+    }
+
+    if (save) {
+      std::ofstream file(baseline_file.c_str(), std::ios::out | std::ios::trunc);
+      if (not file)
+        throw std::string("could not write ") + baseline_file;
+      file << saved.str();
+      std::cout << "baseline saved to " << baseline_file << std::endl;
+    }
+
+    return regression ? 1 : 0;
+  }
+  catch (const parse_error<token<symbol> >&) {
+    std::cout << "parse error" << std::endl;
+    return 1;
+  }
+  catch (const std::string& e) {
+    std::cout << e << std::endl;
+    return 1;
+  }
+}
@@ -0,0 +1,89 @@
+#include <fstream>
+#include <sstream>
+
+#include <cstdio>
+
+#include <spikes/timer.hpp>
+
+#include <parser/parser.hpp>
+#include <lexer/lexer.hpp>
+#include "../src/token_source.hpp"
+
+#include "../src/symbol.hpp"
+#include "../src/lexer.hpp"
+#include "../src/syntax_tree.hpp"
+#include "../src/parser.hpp"
+#include "../src/syntax_checkers.hpp"
+#include "../src/format_check.hpp"
+
+
+/*
+ *  Checks that the reformatted text of a file has no format
+ *  difference with its own tree, and that a change anywhere in it is
+ *  found at its offset.
+ */
+
+using token_type = token<symbol>;
+
+const std::vector<std::string> sources = {
+  "(a=1)\n(b=2)\nendmacro\n",
+  "## header\nFOR i=1 TO 10 DO(\"l\")\n(a=a+i)\nENDDO(\"l\")\nendmacro\n",
+  "IF (a) THEN\n(b=2)\nELSE\n(b=3)\nENDIF\nMACRO M_x.mac\n(c=1)\nendmacro\nENDMACRO M_x.mac\nendmacro\n",
+};
+
+
+int main() {
+  try {
+    cf_grammar<symbol> g(build_cf_grammar());
+    lr_parser<symbol> p(g);
+    alint_token_source tokens;
+    const std::string filename("/tmp/alint_format_check.mac");
+
+    bool success(true);
+    for (const auto& s: sources) {
+      {
+        std::ofstream file(filename.c_str(), std::ios::out | std::ios::trunc);
+        file << s;
+      }
+      tokens.set_file(filename);
+      tree_factory<symbol> factory;
+      silent_error_handler<token_type> handler;
+      basic_node* tree(parse_input_to_tree<alint_token_source,
+                       tree_factory<symbol>,
+                       default_error_handler<token_type> >(p, g, tokens, factory, handler));
+      if (not tree)
+        throw std::string("could not parse ") + s;
+
+      std::ostringstream output;
+      reformat(tree, tokens.get_white_spaces(), output);
+      const std::string formatted(output.str());
+
+      bool ok(find_format_difference(tree, tokens.get_white_spaces(), formatted + "\n")
+              == std::string::npos);
+      for (std::size_t i(0); i < formatted.size(); ++i) {
+        std::string changed(formatted);
+        changed[i] = changed[i] == 'x' ? 'y' : 'x';
+        ok = ok and find_format_difference(tree, tokens.get_white_spaces(), changed) == i;
+      }
+      ok = ok and find_format_difference(tree, tokens.get_white_spaces(),
+                                         formatted + "(a=1)") == formatted.size();
+      delete tree;
+
+      std::cout << (ok ? "ok" : "failed") << std::endl;
+      success = success and ok;
+    }
+    std::remove(filename.c_str());
+
+    if (not success)
+      throw std::string("some format differences were not found.");
+  }
+  catch (const parse_error<token_type>&) {
+    std::cout << "parse error" << std::endl;
+    return 1;
+  }
+  catch (const std::string& e) {
+    std::cout << e << std::endl;
+    return 1;
+  }
+  return 0;
+}
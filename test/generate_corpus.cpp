@@ -0,0 +1,221 @@
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <random>
+
+#include <cstdlib>
+#include <cerrno>
+
+#include <sys/stat.h>
+
+
+/*
+ *  Writes a synthetic corpus of Alucell macros into a directory:
+ *  decks at its root, global macros in global/ and local macros in
+ *  local/. The statements mix assignments, macro calls, FOR, IF and
+ *  MACRO blocks nested up to the given depth, comments in the given
+ *  proportion, and each file refers to fan_out other files of the
+ *  corpus, through inputs or macro calls. The same arguments always
+ *  give the same corpus.
+ *
+ *  usage: generate_corpus directory [files=200] [statements=300]
+ *                         [depth=4] [comment_density=0.15] [fan_out=4]
+ *                         [seed=1]
+ */
+
+class corpus_generator {
+public:
+  corpus_generator(const std::string& directory, std::size_t files,
+                   std::size_t statements, std::size_t depth,
+                   double comment_density, std::size_t fan_out, unsigned int seed)
+    : directory(directory), statements(statements), depth(depth),
+      comment_density(comment_density), fan_out(fan_out), random(seed),
+      globals(files / 4), locals(files / 6),
+      decks(files - globals - locals), label(0) {}
+
+  void generate() {
+    make_directory(directory);
+    make_directory(directory + "/global");
+    make_directory(directory + "/local");
+
+    for (std::size_t i(0); i < decks; ++i)
+      write(directory + "/" + deck_name(i));
+    for (std::size_t i(0); i < globals; ++i)
+      write(directory + "/global/" + global_name(i));
+    for (std::size_t i(0); i < locals; ++i)
+      write(directory + "/local/" + local_name(i));
+  }
+
+private:
+  static void make_directory(const std::string& path) {
+    if (mkdir(path.c_str(), 0755) != 0 and errno != EEXIST)
+      throw std::string("could not create ") + path;
+  }
+
+  static std::string deck_name(std::size_t i) { return "deck_" + std::to_string(i) + ".mac"; }
+  static std::string global_name(std::size_t i) { return "lib_" + std::to_string(i) + ".mac"; }
+  static std::string local_name(std::size_t i) { return "_loc_" + std::to_string(i) + ".mac"; }
+
+  std::size_t pick(std::size_t n) {
+    return std::uniform_int_distribution<std::size_t>(0, n - 1)(random);
+  }
+
+  bool chance(double p) {
+    return std::uniform_real_distribution<double>(0.0, 1.0)(random) < p;
+  }
+
+  std::string variable() {
+    static const char* names[] = { "x", "y", "alpha", "temp", "n_cells", "dt", "rho" };
+    return std::string(names[pick(7)]) + "_" + std::to_string(pick(20));
+  }
+
+  std::string expression(std::size_t terms) {
+    static const char* operators[] = { "+", "-", "*", "/" };
+    std::ostringstream e;
+    for (std::size_t i(0); i < terms; ++i) {
+      if (i)
+        e << operators[pick(4)];
+      switch (pick(4)) {
+      case 0: e << pick(1000); break;
+      case 1: e << pick(10000) << "e-" << pick(9); break;
+      case 2: e << "max(" << variable() << "," << pick(10) << ")"; break;
+      default: e << variable(); break;
+      }
+    }
+    return e.str();
+  }
+
+  std::string reference() {
+    const std::size_t kind(pick(3));
+    if (kind == 0 and decks)
+      return "@\"" + directory + "/" + deck_name(pick(decks)) + "\"";
+    if (kind == 1 and locals)
+      return local_name(pick(locals)) + "(=" + variable() + ";" + expression(2) + ")";
+    if (globals)
+      return global_name(pick(globals)) + "(=" + variable() + ";" + expression(1)
+        + ";\"" + variable() + "\")";
+    return "(" + variable() + "=" + expression(2) + ")";
+  }
+
+  /*
+   *  Comments start at the first column, but a few are indented as the
+   *  code, which the checkers report.
+   */
+  void comment(std::ostream& s, const std::string& indent) {
+    if (chance(0.1))
+      s << indent;
+    if (chance(0.2))
+      s << "## " << std::string(40, '-') << "\n";
+    else
+      s << "# " << variable() << " is updated below, see the manual\n";
+  }
+
+  void block(std::ostream& s, std::size_t level, std::size_t count, bool top) {
+    const std::string indent(2 * level, ' ');
+    for (std::size_t i(0); i < count; ++i) {
+      if (chance(comment_density)) {
+        comment(s, indent);
+        continue;
+      }
+
+      const std::size_t kind(pick(level < depth ? 10 : 6));
+      switch (kind) {
+      case 0: case 1: case 2:
+        s << indent << "(" << variable() << "=" << expression(1 + pick(4)) << ")\n";
+        break;
+      case 3:
+        s << indent << "(" << variable() << "=\"" << variable() << "\")\n";
+        break;
+      case 4:
+        s << indent << "(" << variable() << "(a, b)=a*" << expression(1) << "+b)\n";
+        break;
+      case 5:
+        s << indent << variable() << "\n";
+        break;
+      case 6: case 7: {
+        const std::string guard("loop_" + std::to_string(label++));
+        s << indent << "FOR " << variable() << "=1 TO " << expression(1)
+          << (chance(0.3) ? " STEP 2" : "") << " DO(\"" << guard << "\")\n";
+        block(s, level + 1, 1 + pick(4), false);
+        s << indent << "ENDDO(\"" << guard << "\")\n";
+      }
+        break;
+      case 8:
+        if (chance(0.3))
+          s << indent << "IFDEFINED(" << variable() << ") THEN\n";
+        else
+          s << indent << "IF (" << expression(2) << ") THEN\n";
+        block(s, level + 1, 1 + pick(4), false);
+        if (chance(0.4)) {
+          s << indent << "ELSE\n";
+          block(s, level + 1, 1 + pick(3), false);
+        }
+        s << indent << "ENDIF\n";
+        break;
+      default:
+        if (top) {
+          const std::string name("M_inline_" + std::to_string(label++) + ".mac");
+          s << indent << "MACRO " << name << "\n";
+          block(s, level + 1, 1 + pick(4), false);
+          s << indent << "endmacro\n" << indent << "ENDMACRO " << name << "\n";
+          s << indent << name << "(=" << variable() << ")\n";
+        } else {
+          s << "! echo " << variable() << "\n";
+        }
+        break;
+      }
+    }
+  }
+
+  void write(const std::string& filename) {
+    std::ofstream file(filename.c_str(), std::ios::out | std::ios::trunc);
+    if (not file)
+      throw std::string("could not write ") + filename;
+
+    file << "## generated macro " << filename << "\n";
+    const std::size_t part(statements / (fan_out + 1) + 1);
+    for (std::size_t i(0); i <= fan_out; ++i) {
+      block(file, 0, part, true);
+      if (i < fan_out)
+        file << reference() << "\n";
+    }
+    file << "endmacro\n";
+  }
+
+  std::string directory;
+  std::size_t statements;
+  std::size_t depth;
+  double comment_density;
+  std::size_t fan_out;
+  std::mt19937 random;
+
+  std::size_t globals;
+  std::size_t locals;
+  std::size_t decks;
+  std::size_t label;
+};
+
+
+int main(int argc, char** argv) {
+  try {
+    if (argc < 2)
+      throw std::string("usage: generate_corpus directory [files] [statements] [depth] "
+                        "[comment_density] [fan_out] [seed]");
+
+    corpus_generator generator(argv[1],
+                               argc > 2 ? std::atoi(argv[2]) : 200,
+                               argc > 3 ? std::atoi(argv[3]) : 300,
+                               argc > 4 ? std::atoi(argv[4]) : 4,
+                               argc > 5 ? std::atof(argv[5]) : 0.15,
+                               argc > 6 ? std::atoi(argv[6]) : 4,
+                               argc > 7 ? std::atoi(argv[7]) : 1);
+    generator.generate();
+  }
+  catch (const std::string& e) {
+    std::cout << e << std::endl;
+    return 1;
+  }
+  return 0;
+}
@@ -0,0 +1,233 @@
+#include <fstream>
+#include <sstream>
+#include <algorithm>
+#include <chrono>
+#include <random>
+
+#include <cstdlib>
+
+#include <spikes/timer.hpp>
+
+#include <parser/parser.hpp>
+#include <lexer/lexer.hpp>
+#include "../src/token_source.hpp"
+
+#include "../src/symbol.hpp"
+#include "../src/lexer.hpp"
+#include "../src/syntax_tree.hpp"
+#include "../src/parser.hpp"
+#include "../src/recovery.hpp"
+#include "../src/incremental.hpp"
+
+
+/*
+ *  Applies random edits to generated macro files, and checks that the
+ *  incremental parser gives the tokens and tree of a full parse, also
+ *  when the tree is not read between two updates. Then measures the
+ *  updates of a 50k lines file, and the first read of the tree after
+ *  an update.
+ */
+
+std::string generate_macro_file(std::size_t statements, std::mt19937& random) {
+  std::ostringstream result;
+  for (std::size_t i(0); i < statements; ++i) {
+    switch (random() % 7) {
+    case 0: result << "# comment " << i << "\n"; break;
+    case 1: result << "(a_" << i << "=" << i << "+b*2)\n"; break;
+    case 2: result << "FOR i=1 TO " << i << " DO(\"l\")\n  foo.mac(=x;2)\n  (c=i)\nENDDO(\"l\")\n"; break;
+    case 3: result << "IF (i) THEN\n  _loc.mac()\nELSE\n  ## visual\nENDIF\n"; break;
+    case 4: result << "@\"other.mac\"\n"; break;
+    case 5: result << "MACRO Mm" << i << ".mac\n  x_" << i << "\nendmacro\nENDMACRO Mm" << i << ".mac\n"; break;
+    default: result << "x_" << i << " " << i << ".5\n"; break;
+    }
+  }
+  result << "endmacro\n";
+  return result.str();
+}
+
+/*
+ *  Prints the nodes and the leaves with the ids and positions they
+ *  have in the text, which are shifted in an updated tree.
+ */
+class position_printer: public basic_visitor {
+public:
+  position_printer(std::ostream& stream): stream(stream) {}
+
+  virtual void visit(node& n) {
+    stream << n.get_symbol() << " (\n";
+    for (auto child: n.get_children())
+      child->accept(this);
+    stream << ")\n";
+  }
+
+  virtual void visit(leaf& l) {
+    stream << l.get_symbol() << " (" << l.get_value() << ", " << l.get_id() << ", "
+           << l.get_line() << ":" << l.get_column() << ")\n";
+  }
+
+private:
+  std::ostream& stream;
+};
+
+std::string dump(basic_node* tree, const std::vector<std::string>& white_spaces) {
+  std::ostringstream result;
+  position_printer printer(result);
+  tree->accept(&printer);
+  for (const auto& ws: white_spaces)
+    result << '[' << ws << ']';
+  return result.str();
+}
+
+bool full_parse(lr_parser<symbol>& p, const recovery_table& recovery, alint_token_source& tokens,
+                const std::string& text, std::string& result) {
+  tokens.set_buffer("test.mac", text);
+  try {
+    tree_factory<symbol> factory;
+    silent_error_handler<token_type> handler;
+    basic_node* tree(parse_input_with_recovery(p, recovery, tokens, factory, handler));
+    if (not tree)
+      return false;
+    result = dump(tree, tokens.get_white_spaces());
+    delete tree;
+    return true;
+  }
+  catch (const std::string&) {
+    return false;
+  }
+}
+
+bool incremental_update(incremental_parser& parser,
+                        std::size_t begin, std::size_t end, const std::string& replacement) {
+  try {
+    parser.update(begin, end, replacement);
+    return parser.get_tree();
+  }
+  catch (const std::string&) {
+    return false;
+  }
+}
+
+double median(std::vector<double> samples) {
+  std::sort(samples.begin(), samples.end());
+  return samples[samples.size() / 2];
+}
+
+
+int main(int argc, char** argv) {
+  try {
+    const std::size_t edits(argc > 1 ? std::atoi(argv[1]) : 2000);
+    std::mt19937 random(argc > 2 ? std::atoi(argv[2]) : 1);
+
+    cf_grammar<symbol> g(build_cf_grammar());
+    lr_parser<symbol> p(g);
+    recovery_table recovery(p, g);
+    alint_token_source tokens;
+
+    std::vector<diagnostic> lex_errors;
+    diagnostic_collector() = &lex_errors;
+
+    const std::vector<std::string> snippets{
+      "", " ", "\n", "x", "1", "(", ")", "# c\n", "(b=2)\n", "\"",
+      "IF (a) THEN\n", "ENDIF\n", "foo.mac()", ";", "#{", "}", "endmacro\n", "\n  y z\n"
+    };
+
+    std::size_t incremental_updates(0);
+    incremental_parser parser(p, recovery);
+    for (std::size_t i(0); i < edits; ++i) {
+      if (i % 200 == 0) {
+        parser.set_text("test.mac", generate_macro_file(60, random));
+        if (parser.get_parse_errors().size())
+          throw std::string("the generated macro file doesn't parse.");
+      }
+
+      /*
+       *  Each edit is undone afterwards, so that most edits apply to a
+       *  text which parses. Some edits are not checked, so that the
+       *  next update comes before the tree is read.
+       */
+      const std::size_t begin(random() % (parser.get_text().size() + 1));
+      const std::size_t end(std::min(parser.get_text().size(), begin + (random() % 3 ? 0 : random() % 12)));
+      const std::string replacement(snippets[random() % snippets.size()]);
+      const std::string removed(parser.get_text().substr(begin, end - begin));
+      bool checked(random() % 3);
+
+      for (const auto& edit: {std::make_pair(end, replacement),
+                              std::make_pair(begin + replacement.size(), removed)}) {
+        if (not checked) {
+          try {
+            parser.update(begin, edit.first, edit.second);
+          }
+          catch (const std::string&) {}
+          checked = true;
+          continue;
+        }
+
+        std::string text(parser.get_text());
+        text.replace(begin, edit.first - begin, edit.second);
+
+        std::string expected, result;
+        const bool expected_success(full_parse(p, recovery, tokens, text, expected));
+        const bool success(incremental_update(parser, begin, edit.first, edit.second));
+        if (success)
+          result = dump(parser.get_tree(), parser.get_white_spaces());
+
+        if (success != expected_success or result != expected) {
+          std::cout << "edit " << i << ": [" << begin << ", " << edit.first << ") replaced by \""
+                    << edit.second << "\" differs from a full parse in:" << std::endl
+                    << text << std::endl;
+          return 1;
+        }
+        incremental_updates += parser.was_incremental();
+      }
+    }
+
+    std::cout << 2 * edits << " random edits checked, "
+              << incremental_updates << " made incrementally." << std::endl;
+
+    /*
+     *  Update times on a 50k lines file.
+     */
+    const std::string text(generate_macro_file(16000, random));
+    const std::size_t lines(std::count(text.begin(), text.end(), '\n'));
+
+    using clock = std::chrono::steady_clock;
+    const clock::time_point start(clock::now());
+    parser.set_text("test.mac", text);
+    std::cout << lines << " lines parsed in "
+              << std::chrono::duration<double, std::milli>(clock::now() - start).count()
+              << "ms" << std::endl;
+
+    const std::size_t middle(text.find("(a_", text.size() / 2));
+    const std::vector<std::pair<std::string, std::vector<std::string> > > scenarios{
+      {"change a character", {"(z_", "(a_"}},
+      {"insert a statement in a line", {"(b=2) (a_", "(a_"}},
+      {"insert a line", {"(b=2)\n(a_", "(a_"}}
+    };
+
+    for (const auto& scenario: scenarios) {
+      std::vector<double> samples, read_samples;
+      bool all_incremental(true);
+      for (std::size_t i(0); i < 50; ++i) {
+        const std::string& current(i % 2 ? scenario.second[0] : "(a_");
+        const std::string& replacement(scenario.second[i % 2 ? 1 : 0]);
+        const clock::time_point edit_start(clock::now());
+        parser.update(middle, middle + current.size(), replacement);
+        const clock::time_point edit_end(clock::now());
+        samples.push_back(std::chrono::duration<double, std::milli>(edit_end - edit_start).count());
+        if (i >= 40) {
+          parser.get_tree();
+          read_samples.push_back(std::chrono::duration<double, std::milli>(clock::now() - edit_end).count());
+        }
+        all_incremental = all_incremental and parser.was_incremental();
+      }
+      std::cout << scenario.first << ": median " << median(samples) << "ms, then "
+                << median(read_samples) << "ms for the first read of the tree"
+                << (all_incremental ? "" : " (not incremental)") << std::endl;
+    }
+  }
+  catch (const std::string& e) {
+    std::cout << e << std::endl;
+    return 1;
+  }
+  return 0;
+}
@@ -0,0 +1,122 @@
+#include <fstream>
+#include <sstream>
+#include <chrono>
+#include <thread>
+#include <cstdint>
+
+#include <cstdlib>
+
+#include <spikes/timer.hpp>
+
+#include <parser/parser.hpp>
+#include <lexer/lexer.hpp>
+#include "../src/token_source.hpp"
+
+#include "../src/symbol.hpp"
+#include "../src/lexer.hpp"
+#include "../src/parallel_lexer.hpp"
+
+
+/*
+ *  Lexes a generated macro file of the given size in megabytes, 500 by
+ *  default, sequentially and then on 2 up to the given number of
+ *  threads, and checks that the tokens, coordinates and white spaces
+ *  are identical. All the tokens are kept in memory, which takes many
+ *  times the size of the file.
+ */
+
+std::string generate_macro_file(std::size_t size) {
+  std::ostringstream result;
+  for (std::size_t i(0); static_cast<std::size_t>(result.tellp()) < size; ++i) {
+    switch (i % 8) {
+    case 0: result << "# comment \"" << i << " with a quote\n"; break;
+    case 1: result << "(a_" << i << "=" << i << "+b*2.5e-3)\n"; break;
+    case 2: result << "FOR i=1 TO " << i << " DO(\"loop\n label\")\n  foo.mac(=x;2)\nENDDO(\"loop\n label\")\n"; break;
+    case 3: result << "IF (i) THEN\n  _loc.mac(\"a string\nover two lines\")\nELSE\n  ## visual\nENDIF\n"; break;
+    case 4: result << "@\"other.mac\"\n! echo \"shell\n"; break;
+    case 5: result << "MACRO Mm" << i << ".mac\n  x_#{a" << i << "}\nendmacro\nENDMACRO Mm" << i << ".mac\n"; break;
+    case 6: result << "\t\r\n\n   \n"; break;
+    default: result << "x_" << i << " " << i << ".5 {a, b; c}\n"; break;
+    }
+  }
+  result << "endmacro\n";
+  return result.str();
+}
+
+std::uint64_t fingerprint(const std::vector<token<symbol>*>& lexems,
+                          const std::vector<std::string>& white_spaces) {
+  std::uint64_t hash(14695981039346656037ull);
+  auto combine([&hash](const std::string& s) {
+      for (const char c: s) {
+        hash ^= static_cast<unsigned char>(c);
+        hash *= 1099511628211ull;
+      }
+      hash ^= 0xff;
+      hash *= 1099511628211ull;
+    });
+
+  for (std::size_t i(0); i < lexems.size(); ++i) {
+    std::ostringstream symbol_name;
+    symbol_name << lexems[i]->symbol;
+    combine(symbol_name.str());
+    combine(lexems[i]->value);
+    combine(lexems[i]->render_coordinates());
+    combine(white_spaces[i]);
+  }
+  return hash;
+}
+
+double elapsed_since(std::chrono::steady_clock::time_point start) {
+  return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+
+int main(int argc, char** argv) {
+  using token_type = token<symbol>;
+  try {
+    const std::size_t megabytes(argc > 1 ? std::atoi(argv[1]) : 500);
+    const std::size_t jobs(argc > 2 ? std::atoi(argv[2]) : std::thread::hardware_concurrency());
+
+    const std::string text(generate_macro_file(megabytes << 20));
+
+    std::uint64_t expected(0);
+    double sequential_time(0.0);
+    {
+      alint_token_source tokens;
+      std::chrono::steady_clock::time_point start(std::chrono::steady_clock::now());
+      tokens.set_buffer("bench.mac", text);
+      tokens.lex_to_end();
+      sequential_time = elapsed_since(start);
+
+      std::cout << megabytes << "MB, " << tokens.get_lexems().size() << " tokens lexed in "
+                << sequential_time << "ms" << std::endl;
+      expected = fingerprint(tokens.get_lexems(), tokens.get_white_spaces());
+    }
+
+    for (std::size_t j(2); j <= jobs; ++j) {
+      std::vector<token_type*> lexems;
+      std::vector<std::string> white_spaces;
+
+      std::chrono::steady_clock::time_point start(std::chrono::steady_clock::now());
+      const bool parallel(lex_in_parallel("bench.mac", text, j, lexems, white_spaces));
+      const double time(elapsed_since(start));
+
+      if (not parallel)
+        throw std::string("the file was not lexed in parallel.");
+
+      const bool same(fingerprint(lexems, white_spaces) == expected);
+      for (auto t: lexems)
+        delete t;
+
+      std::cout << j << " threads: " << time << "ms, speedup "
+                << sequential_time / time << std::endl;
+      if (not same)
+        throw std::string("the tokens differ from the sequential lexing.");
+    }
+  }
+  catch (const std::string& e) {
+    std::cout << e << std::endl;
+    return 1;
+  }
+  return 0;
+}
@@ -0,0 +1,93 @@
+#include <iostream>
+#include <chrono>
+
+#include "../src/libalint.hpp"
+
+
+/*
+ *  Uses libalint as an embedding program would, through its public
+ *  header only, and measures the cost of a validation call.
+ */
+
+void expect(bool condition, const std::string& what) {
+  if (not condition)
+    throw std::string("failed: ") + what;
+}
+
+
+int main() {
+  try {
+    alint::context c;
+    c.set_macro_directories("/global/", "/local/");
+
+    const std::string deck("## header\n"
+                           "@\"other.mac\"\n"
+                           "(a=1)\n"
+                           "FOR i=1 TO 10 DO(\"loop\")\n"
+                           "  foo.mac(=x;2)\n"
+                           "  IF (i) THEN\n"
+                           "    _loc.mac()\n"
+                           "  ENDIF\n"
+                           "ENDDO(\"lop\")\n"
+                           "endmacro\n");
+
+    const alint::document d(c.parse_buffer("deck.mac", deck));
+    expect(d.parsed() and d.get_tree() and d.get_diagnostics().empty(), "parse a valid buffer");
+
+    const std::vector<alint::diagnostic> warnings(c.check(d, alint::do_enddo_guards));
+    expect(warnings.size() == 1 and warnings[0].severity == alint::severity::warning
+           and warnings[0].line == 9, "report the DO/ENDDO guard mismatch");
+    expect(c.check(d, alint::no_rules).empty(), "run no rule");
+
+    const std::vector<alint::dependency> dependencies(c.get_dependencies(d));
+    expect(dependencies.size() == 3, "find the dependencies");
+    for (const auto& dependency: dependencies)
+      expect((dependency.filename == "other.mac" and dependency.kind == alint::dependency_kind::input)
+             or (dependency.filename == "/global/foo.mac"
+                 and dependency.kind == alint::dependency_kind::global_macro)
+             or (dependency.filename == "/local/_loc.mac"
+                 and dependency.kind == alint::dependency_kind::local_macro),
+             "resolve " + dependency.filename);
+
+    const alint::document broken(c.parse_buffer("broken.mac", "(a=1\nendmacro\n"));
+    expect(not broken.parsed() and broken.get_diagnostics().size() == 1
+           and broken.get_diagnostics()[0].severity == alint::severity::error
+           and broken.get_diagnostics()[0].line == 2, "report a parse error");
+
+    const alint::document recovered(c.parse_buffer("recovered.mac",
+                                                   "(a=1\n" + deck.substr(deck.find("FOR"))));
+    expect(not recovered.parsed() and recovered.get_tree()
+           and recovered.get_diagnostics().size() == 1
+           and c.get_dependencies(recovered).size() == 2
+           and c.check(recovered, alint::do_enddo_guards).size() == 1,
+           "check the statements after a parse error");
+
+    const std::vector<alint::diagnostic> missing(c.validate_file("/nonexistent/file.mac"));
+    expect(missing.size() == 1 and missing[0].severity == alint::severity::error,
+           "report a missing file");
+
+    const std::vector<alint::diagnostic> nested(c.validate_buffer("nested.mac",
+                                                                  std::string(2000, '(') + "\nendmacro\n"));
+    expect(not nested.empty() and nested.back().severity == alint::severity::error
+           and nested.back().message.find("nesting") != std::string::npos,
+           "report the nesting limit");
+
+    /*
+     *  The cost of a validation once the context is built.
+     */
+    using clock = std::chrono::steady_clock;
+    const std::size_t expected(c.check(d).size());
+    const std::size_t calls(1000);
+    const clock::time_point start(clock::now());
+    for (std::size_t i(0); i < calls; ++i)
+      expect(c.validate_buffer("deck.mac", deck).size() == expected, "validate the buffer");
+    std::cout << "validation of a " << deck.size() << " bytes buffer: "
+              << std::chrono::duration<double, std::micro>(clock::now() - start).count() / calls
+              << "us" << std::endl;
+  }
+  catch (const std::string& e) {
+    std::cout << e << std::endl;
+    return 1;
+  }
+  return 0;
+}
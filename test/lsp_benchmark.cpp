@@ -0,0 +1,188 @@
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <cstdio>
+#include <cstdlib>
+
+#include <unistd.h>
+#include <sys/wait.h>
+
+#include "../src/json.hpp"
+
+
+/*
+ *  Drives "alint --lsp" with scripted edits of a macro file, and
+ *  reports the latency of the diagnostics and of the document symbol
+ *  requests.
+ */
+
+void send(FILE* stream, const json_value& message) {
+  const std::string content(message.dump());
+  std::fprintf(stream, "Content-Length: %zu\r\n\r\n", content.size());
+  std::fwrite(content.data(), 1, content.size(), stream);
+  std::fflush(stream);
+}
+
+json_value receive(FILE* stream) {
+  std::size_t length(0);
+  char line[256];
+  while (std::fgets(line, sizeof(line), stream)) {
+    if (line[0] == '\r' or line[0] == '\n')
+      break;
+    std::sscanf(line, "Content-Length: %zu", &length);
+  }
+
+  std::string content(length, '\0');
+  if (std::fread(&content[0], 1, length, stream) != length)
+    throw std::string("error: the server closed the connection.");
+  return json_value::parse(content);
+}
+
+json_value wait_for(FILE* stream, const std::string& method, int id) {
+  while (true) {
+    json_value message(receive(stream));
+    if (method.empty()) {
+      if (message["id"].get_type() == json_value::type::number
+          and message["id"].get_number() == id)
+        return message;
+    } else if (message["method"].get_string() == method) {
+      return message;
+    }
+  }
+}
+
+json_value notification(const std::string& method, const json_value& params) {
+  return json_value::object()
+    .set("jsonrpc", "2.0")
+    .set("method", method)
+    .set("params", params);
+}
+
+json_value request(int id, const std::string& method, const json_value& params) {
+  return notification(method, params).set("id", id);
+}
+
+void report(const std::string& name, std::vector<double> samples) {
+  std::sort(samples.begin(), samples.end());
+  std::cout << name
+            << ": min " << samples.front()
+            << "ms, median " << samples[samples.size() / 2]
+            << "ms, p90 " << samples[samples.size() * 9 / 10]
+            << "ms, max " << samples.back() << "ms" << std::endl;
+}
+
+int main(int argc, char** argv) {
+  try {
+    if (argc < 3)
+      throw std::string("usage: lsp_benchmark <alint binary> <file.mac> [edits]");
+
+    const std::string alint(argv[1]);
+    const std::string filename(argv[2]);
+    const std::size_t edits(argc > 3 ? std::atoi(argv[3]) : 200);
+
+    std::ifstream file(filename.c_str());
+    if (not file)
+      throw std::string("could not open ") + filename;
+    std::ostringstream content;
+    content << file.rdbuf();
+    const std::string text(content.str());
+    const std::size_t lines(std::count(text.begin(), text.end(), '\n'));
+    if (lines < 2)
+      throw std::string("the file is too short for the edit script.");
+
+    int to_server[2], from_server[2];
+    if (pipe(to_server) != 0 or pipe(from_server) != 0)
+      throw std::string("error: pipe failed.");
+
+    const pid_t pid(fork());
+    if (pid == 0) {
+      dup2(to_server[0], 0);
+      dup2(from_server[1], 1);
+      close(to_server[1]);
+      close(from_server[0]);
+      execl(alint.c_str(), alint.c_str(), "--lsp", static_cast<char*>(nullptr));
+      std::_Exit(127);
+    }
+    close(to_server[0]);
+    close(from_server[1]);
+    FILE* output(fdopen(to_server[1], "w"));
+    FILE* input(fdopen(from_server[0], "r"));
+
+    char* path(realpath(filename.c_str(), nullptr));
+    const std::string uri("file://" + std::string(path ? path : filename.c_str()));
+    std::free(path);
+    int id(0);
+    send(output, request(++id, "initialize", json_value::object()));
+    wait_for(input, "", id);
+    send(output, notification("initialized", json_value::object()));
+
+    using clock = std::chrono::steady_clock;
+    const clock::time_point open_start(clock::now());
+    send(output, notification("textDocument/didOpen", json_value::object()
+                              .set("textDocument", json_value::object()
+                                   .set("uri", uri)
+                                   .set("languageId", "alucell")
+                                   .set("version", 0)
+                                   .set("text", text))));
+    wait_for(input, "textDocument/publishDiagnostics", 0);
+    std::cout << "open: "
+              << std::chrono::duration<double, std::milli>(clock::now() - open_start).count()
+              << "ms" << std::endl;
+
+    /*
+     *  The edit script alternately inserts and removes a comment line
+     *  at different places of the file, as an author would, and sends
+     *  the changed ranges only.
+     */
+    std::vector<double> diagnostics_latency, symbols_latency;
+    for (std::size_t i(0); i < edits; ++i) {
+      const std::size_t position((i / 2 * 7919) % (lines - 1));
+      const std::string inserted(i % 2 == 0 ? "# edit " + std::to_string(i) + "\n" : "");
+      const json_value range(json_value::object()
+                             .set("start", json_value::object()
+                                  .set("line", position).set("character", 0))
+                             .set("end", json_value::object()
+                                  .set("line", position + (i % 2)).set("character", 0)));
+
+      const clock::time_point start(clock::now());
+      send(output, notification("textDocument/didChange", json_value::object()
+                                .set("textDocument", json_value::object()
+                                     .set("uri", uri)
+                                     .set("version", static_cast<int>(i + 1)))
+                                .set("contentChanges", json_value::array()
+                                     .push_back(json_value::object()
+                                                .set("range", range)
+                                                .set("text", inserted)))));
+      wait_for(input, "textDocument/publishDiagnostics", 0);
+      const clock::time_point published(clock::now());
+
+      send(output, request(++id, "textDocument/documentSymbol", json_value::object()
+                           .set("textDocument", json_value::object().set("uri", uri))));
+      wait_for(input, "", id);
+      const clock::time_point answered(clock::now());
+
+      diagnostics_latency.push_back(std::chrono::duration<double, std::milli>(published - start).count());
+      symbols_latency.push_back(std::chrono::duration<double, std::milli>(answered - published).count());
+    }
+
+    report("diagnostics after edit", diagnostics_latency);
+    report("document symbols", symbols_latency);
+
+    send(output, request(++id, "shutdown", json_value()));
+    wait_for(input, "", id);
+    send(output, notification("exit", json_value()));
+    std::fclose(output);
+    std::fclose(input);
+    waitpid(pid, nullptr, 0);
+  }
+  catch (const std::string& e) {
+    std::cout << e << std::endl;
+    return 1;
+  }
+  return 0;
+}
@@ -0,0 +1,104 @@
+#include <fstream>
+#include <sstream>
+#include <chrono>
+#include <thread>
+
+#include <cstdlib>
+
+#include <spikes/timer.hpp>
+
+#include <parser/parser.hpp>
+#include <lexer/lexer.hpp>
+#include "../src/token_source.hpp"
+
+#include "../src/symbol.hpp"
+#include "../src/lexer.hpp"
+#include "../src/syntax_tree.hpp"
+#include "../src/parser.hpp"
+#include "../src/recovery.hpp"
+#include "../src/parallel_parser.hpp"
+
+
+/*
+ *  Parses a file sequentially, then in parallel with 2 up to the given
+ *  number of jobs, and checks that the trees are identical.
+ */
+
+/*
+ *  The indentation of show() grows with the depth of the statement
+ *  list, which is too large for huge files: the tree is dumped flat.
+ */
+class tree_dumper: public basic_visitor {
+public:
+  virtual void visit(node& n) {
+    result << n.get_symbol() << ' ' << n.get_production_id() << " {";
+    for (auto c: n.get_children())
+      c->accept(this);
+    result << "}\n";
+  }
+
+  virtual void visit(leaf& l) {
+    result << l.get_symbol() << " (" << l.get_value() << ", " << l.get_id() << ", "
+           << l.get_lexem_coordinates()->render() << ")\n";
+  }
+
+  std::ostringstream result;
+};
+
+std::string dump(basic_node* tree) {
+  tree_dumper dumper;
+  tree->accept(&dumper);
+  return dumper.result.str();
+}
+
+double elapsed_since(std::chrono::steady_clock::time_point start) {
+  return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+
+int main(int argc, char** argv) {
+  using token_type = token<symbol>;
+  try {
+    if (argc < 2)
+      throw std::string("please give me a filename.");
+    const std::string filename(argv[1]);
+    const std::size_t jobs(argc > 2 ? std::atoi(argv[2]) : std::thread::hardware_concurrency());
+
+    cf_grammar<symbol> g(build_cf_grammar());
+    lr_parser<symbol> p(g);
+    recovery_table recovery(p, g);
+
+    alint_token_source tokens;
+    tokens.set_file(filename);
+    tokens.lex_to_end();
+    const std::vector<token_type*>& lexems(tokens.get_lexems());
+
+    silent_error_handler<token_type> handler;
+    std::chrono::steady_clock::time_point start(std::chrono::steady_clock::now());
+    basic_node* tree(parse_in_parallel(p, recovery, lexems, 1, handler));
+    std::cout << lexems.size() << " tokens parsed in " << elapsed_since(start) << "ms" << std::endl;
+    const std::string expected(dump(tree));
+    delete tree;
+
+    for (std::size_t j(2); j <= jobs; ++j) {
+      start = std::chrono::steady_clock::now();
+      tree = parse_in_parallel(p, recovery, lexems, j, handler);
+      const double time(elapsed_since(start));
+      const bool same(dump(tree) == expected);
+      delete tree;
+
+      std::cout << j << " jobs: " << time << "ms" << std::endl;
+      if (not same)
+        throw std::string("the tree differs from the sequential parse.");
+    }
+  }
+  catch (const parse_error<token<symbol> >&) {
+    std::cout << "parse error" << std::endl;
+    return 1;
+  }
+  catch (const std::string& e) {
+    std::cout << e << std::endl;
+    return 1;
+  }
+  return 0;
+}
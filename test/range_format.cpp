@@ -0,0 +1,118 @@
+#include <fstream>
+#include <sstream>
+
+#include <cstdio>
+
+#include <spikes/timer.hpp>
+
+#include <parser/parser.hpp>
+#include <lexer/lexer.hpp>
+#include "../src/token_source.hpp"
+
+#include "../src/symbol.hpp"
+#include "../src/lexer.hpp"
+#include "../src/syntax_tree.hpp"
+#include "../src/parser.hpp"
+#include "../src/syntax_checkers.hpp"
+#include "../src/range_format.hpp"
+
+
+/*
+ *  Checks that the edits of a range covering a whole file give its
+ *  reformatted text, and that a range within the body of a block
+ *  statement only reformats statements of that body.
+ */
+
+using token_type = token<symbol>;
+
+struct range_case {
+  std::string text;
+  std::size_t first_line;
+  std::size_t last_line;
+  std::size_t edits;
+};
+
+const std::vector<range_case> cases = {
+  { "(a=1)\n   (b=2)\nendmacro\n", 2, 2, 1 },
+  { "FOR i=1 TO 10 DO(\"l\")\n(a=a+i)\n (b=b+i)\nENDDO(\"l\")\nendmacro\n", 2, 3, 2 },
+  { "IF (a) THEN\n(b=2)\nELSE\n  IF (b) THEN\n(c=3)\n  ENDIF\nENDIF\nendmacro\n", 5, 5, 1 },
+  { "MACRO M_x.mac\n(c=1)\nendmacro\nENDMACRO M_x.mac\nendmacro\n", 2, 2, 1 },
+};
+
+
+std::string apply_edits(const std::string& text, const std::vector<text_edit>& edits) {
+  std::vector<std::size_t> line_offsets(1, 0);
+  for (std::size_t i(0); i < text.size(); ++i)
+    if (text[i] == '\n')
+      line_offsets.push_back(i + 1);
+
+  std::string result(text);
+  for (auto e(edits.rbegin()); e != edits.rend(); ++e) {
+    const std::size_t first(line_offsets[e->first_line - 1] + e->first_column);
+    const std::size_t last(line_offsets[e->last_line - 1] + e->last_column);
+    result.replace(first, last - first, e->text);
+  }
+  return result;
+}
+
+
+std::string trim(const std::string& text) {
+  return text.substr(0, text.find_last_not_of(" \t\n") + 1);
+}
+
+
+int main() {
+  try {
+    cf_grammar<symbol> g(build_cf_grammar());
+    lr_parser<symbol> p(g);
+    alint_token_source tokens;
+    const std::string filename("/tmp/alint_range_format.mac");
+
+    bool success(true);
+    for (const auto& c: cases) {
+      {
+        std::ofstream file(filename.c_str(), std::ios::out | std::ios::trunc);
+        file << c.text;
+      }
+      tokens.set_file(filename);
+      tree_factory<symbol> factory;
+      silent_error_handler<token_type> handler;
+      basic_node* tree(parse_input_to_tree<alint_token_source,
+                       tree_factory<symbol>,
+                       default_error_handler<token_type> >(p, g, tokens, factory, handler));
+      if (not tree)
+        throw std::string("could not parse ") + c.text;
+
+      node* statements(static_cast<node*>(find_macro_file(tree)->get_children()[0]));
+      std::ostringstream output;
+      reformat(tree, tokens.get_white_spaces(), output);
+
+      range_formatter whole(tokens.get_white_spaces(), 1, c.text.size());
+      whole.format(statements, nullptr);
+      bool ok(trim(apply_edits(c.text, whole.get_edits())) == trim(output.str()));
+
+      range_formatter part(tokens.get_white_spaces(), c.first_line, c.last_line);
+      part.format(statements, nullptr);
+      ok = ok and part.get_edits().size() == c.edits;
+      for (const auto& e: part.get_edits())
+        ok = ok and e.first_line + 1 >= c.first_line and e.last_line <= c.last_line;
+      delete tree;
+
+      std::cout << (ok ? "ok" : "failed") << std::endl;
+      success = success and ok;
+    }
+    std::remove(filename.c_str());
+
+    if (not success)
+      throw std::string("some ranges were not reformatted.");
+  }
+  catch (const parse_error<token_type>&) {
+    std::cout << "parse error" << std::endl;
+    return 1;
+  }
+  catch (const std::string& e) {
+    std::cout << e << std::endl;
+    return 1;
+  }
+  return 0;
+}
@@ -1,6 +1,7 @@
 #include <fstream>
 
 #include <cstdlib>
+#include <cstdio>
 
 #include <spikes/timer.hpp>
 
@@ -12,144 +13,107 @@
 #include "../src/lexer.hpp"
 #include "../src/syntax_tree.hpp"
 #include "../src/parser.hpp"
+#include "../src/recovery.hpp"
+#include "../src/syntax_checkers.hpp"
+
+
+/*
+ *  Parses files with several syntax errors and checks that each one
+ *  is reported, in one pass, and that the recovered tree still goes
+ *  through the checkers. With a filename, parses that file and prints
+ *  its errors and its tree.
+ */
+
+using token_type = token<symbol>;
+
+struct counting_handler: public default_error_handler<token_type> {
+  virtual void operator()(const parse_error<token_type>& e) {
+    std::cout << e.get_unexpected_token().render_coordinates()
+              << ": " << parse_error_message(e) << std::endl;
+    const file_source_coordinate_range* c(
+      dynamic_cast<const file_source_coordinate_range*>(
+        e.get_unexpected_token().get_coordinates()));
+    lines.push_back(c->get_line());
+  }
 
-template<typename token_source_type>
-bool parse_input_with_recovery(lr_parser<typename token_source_type::symbol_type>& parser,
-                               cf_grammar<typename token_source_type::symbol_type>& grammar,
-                               token_source_type& input) {
-  using symbol_type = typename token_source_type::symbol_type;
-  
-  std::list<unsigned int> state_stack;
-  std::list<symbol_type> symbol_stack;
-  state_stack.push_back(0);
-
-  while(state_stack.back() != parser.accepting_state) {
-    const auto terminal_map_item(parser.terminal_map.find(input.get().symbol));
-    if (terminal_map_item == parser.terminal_map.end())
-      throw std::string("parse error near ") + input.get().render_coordinates();
-    
-    const unsigned int terminal_id(terminal_map_item->second);
-    const int action(parser.transitions_table[ state_stack.back() ][ terminal_id ]);
-
-    if(action > 0) {  // shift
-      state_stack.push_back(action - 1);
-      symbol_stack.push_back(input.get().symbol);
-      input.next();
-    } else if(action < 0) {  // reduce
-      const unsigned int production_rule_id(-action-1);
-      const unsigned int non_terminal_symbol_id(parser.non_terminal_map[parser.reduce_symbol[production_rule_id]]);
-
-      pop(state_stack, parser.rule_lengths[production_rule_id]);
-      state_stack.push_back(parser.goto_table[ state_stack.back() ][ non_terminal_symbol_id ] - 1);
-      
-      pop(symbol_stack, parser.rule_lengths[production_rule_id]);
-      symbol_stack.push_back(parser.reduce_symbol[production_rule_id]);
-    } else {
-      std::cout << input.get().get_coordinates()->render()
-                << ": syntax error, unexpected " << input.get().symbol << std::endl;
-
-      /*
-       *  Print the state stack
-       */
-      /*std::cout << "state stack: ";
-      for (const auto& s: state_stack)
-        std::cout << s << " ";
-        std::cout << std::endl;*/
-
-      /*
-       *  Print the symbol stack
-       */
-      /*std::cout << "symbol stack: ";
-      for (const auto& s: symbol_stack)
-        std::cout << s << " ";
-        std::cout << std::endl;*/
-      
-      /*
-       *  Save the state and symbol stack in a random access structure
-       */
-      std::vector<unsigned int> states(state_stack.begin(), state_stack.end());
-      std::vector<symbol_type> symbols(symbol_stack.begin(), symbol_stack.end());
-      
-      /*
-       *  build maps from symbol ids to symbols.
-       */
-      std::map<unsigned int, symbol> symbol_id_map;
-      for (const auto& i: parser.non_terminal_map)
-        symbol_id_map[i.second] = i.first;
-
-      for (const auto& i: parser.terminal_map)
-        symbol_id_map[i.second] = i.first;
-
-      for (unsigned int i(states.size()); i > 0; --i) {
-        /*if (i == 1)
-          std::cout << "available reduction goals following nothing at stack location "
-                    << i-1 << " which accepts a "
-                    << input.get().symbol << ": ";
-        else
-          std::cout << "available reduction goals following a "
-                    << symbols[i-2]
-                    << " at stack location " << i-1 << " which accepts a "
-                    << input.get().symbol << ": ";*/
-
-        std::set<symbol> candidate_reduction_goals;
-        const std::vector<short>& goto_line(parser.goto_table[states[i-1]]);
-        for (const auto& s: parser.non_terminal_map)
-          if (goto_line[s.second]) {
-            const unsigned int candidate_state(goto_line[s.second] - 1);
-            if (parser.transitions_table[candidate_state][terminal_id])
-              candidate_reduction_goals.insert(grammar.get_important_goal(s.first));
-          }
-        /*
-         * Display the candidate set
-         */
-        /*for (const auto& s: candidate_reduction_goals)
-          std::cout << s << " ";
-          std::cout << std::endl;*/
-
-        
-        if (not candidate_reduction_goals.empty()) {
-          const symbol_type reduction_goal(*candidate_reduction_goals.begin());
-          const unsigned int reduction_goal_id(parser.non_terminal_map[reduction_goal]);
-          
-          pop(state_stack, states.size() - i);
-          state_stack.push_back(parser.goto_table[ state_stack.back() ][ reduction_goal_id ] - 1);
-      
-          pop(symbol_stack, states.size() - i);
-          symbol_stack.push_back(reduction_goal);
-
-          break;
-        }
-      }
-        
-      //return false;
-    }
+  std::vector<std::size_t> lines;
+};
+
+
+struct recovery_case {
+  std::string name;
+  std::string text;
+  std::vector<std::size_t> lines;
+};
+
+const std::vector<recovery_case> cases = {
+  { "no error", "(a=1)\n(b=2)\nendmacro\n", {} },
+  { "two bad assignments",
+    "(a=1)\n(b==2)\n(c=3)\n(d=+*4)\n(e=5)\nendmacro\n", { 2, 4 } },
+  { "errors in blocks",
+    "FOR i=1 TO 2 DO(\"l\")\n  (a=)\nENDDO(\"l\")\n"
+    "IF (a) THEN\n  (b=2\nENDIF\n(c=3)\nendmacro\n", { 2, 6 } },
+  { "missing endmacro", "(a=1)\n(b=2)\n", { 3 } },
+};
+
+
+bool check(const recovery_case& c, lr_parser<symbol>& p, const recovery_table& recovery,
+           alint_token_source& tokens) {
+  const std::string filename("/tmp/alint_recovery.mac");
+  {
+    std::ofstream file(filename.c_str(), std::ios::out | std::ios::trunc);
+    file << c.text;
+  }
+
+  tokens.set_file(filename);
+  tree_factory<symbol> factory;
+  counting_handler handler;
+  basic_node* tree(parse_input_with_recovery(p, recovery, tokens, factory, handler));
+  std::remove(filename.c_str());
+
+  bool result(tree and handler.lines == c.lines);
+  if (tree) {
+    std::vector<diagnostic> diagnostics;
+    diagnostic_collector() = &diagnostics;
+    check_do_enddo_guards(tree);
+    check_white_spaces(tree, tokens.get_white_spaces());
+    diagnostic_collector() = nullptr;
+    delete tree;
   }
-  return true;
+
+  std::cout << c.name << ": " << (result ? "ok" : "failed") << std::endl;
+  return result;
 }
 
 
 int main(int argc, char** argv) {
   try {
-    if (argc != 2)
-      throw std::string("please give me a filename.");
-    const std::string filename(argv[1]);
-
     cf_grammar<symbol> g(build_cf_grammar());
     lr_parser<symbol> p(g);
-
-    //p.print(std::cout, g);
-    
+    recovery_table recovery(p, g);
     alint_token_source tokens;
-    tokens.set_file(filename);
 
-    default_error_handler<token_type> handler;
-    bool result(parse_input<alint_token_source>(p, g, tokens, handler));
-    //bool result(parse_input_with_recovery<alint_token_source>(p, g, tokens));
+    if (argc == 2) {
+      tokens.set_file(argv[1]);
+      tree_factory<symbol> factory;
+      counting_handler handler;
+      basic_node* tree(parse_input_with_recovery(p, recovery, tokens, factory, handler));
+      if (tree)
+        tree->show(std::cout);
+      delete tree;
+      std::cout << (tree and handler.lines.empty() ? "good" : "bad") << std::endl;
+      return 0;
+    }
 
-    std::cout << (result ? "good" : "bad") << std::endl;
+    bool success(true);
+    for (const auto& c: cases)
+      success = check(c, p, recovery, tokens) and success;
+    if (not success)
+      throw std::string("some errors were not recovered from.");
   }
   catch (const std::string& e) {
     std::cout << e << std::endl;
+    return 1;
   }
   return 0;
 }